@@ -18,9 +18,13 @@
 #include <string.h>
 #include <strings.h>
 #include <ctype.h>
+#include <errno.h>
+#include <signal.h>
 
 #include <stdlib.h>
 #include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include <wctype.h>
@@ -286,11 +290,15 @@ static int DidAMonth;
 static int DidAWeek;
 static int DidADay;
 
+/* Last day the calendar covers */
+static int CalLastDay;
+
 static char const *CalendarTime(int tim, int duration);
 static void ColorizeEntry(CalEntry const *e, int clamp);
 static void SortCol (CalEntry **col);
 static void DoCalendarOneWeek (int nleft);
 static void DoCalendarOneMonth (void);
+static void DoCalendarMonthsInParallel (void);
 static void DoSimpleCalendarOneMonth (void);
 static int WriteCalendarRow (void);
 static void WriteWeekHeaderLine (void);
@@ -390,74 +398,74 @@ despace(char const *s)
     return buf;
 }
 
-static void PrintJSONChar(char c) {
+/* Characters that can't appear raw inside a JSON string */
+#define JSON_NEEDS_ESCAPE(c) ((unsigned char) (c) < 32 || (c) == '"' || (c) == '\\' || (c) == 0x7f)
+
+static void PrintJSONEscape(char c)
+{
     switch(c) {
-    case '\b': printf("\\b"); break;
-    case '\f': printf("\\f"); break;
-    case '\n': printf("\\n"); break;
-    case '\r': printf("\\r"); break;
-    case '\t': printf("\\t"); break;
-    case '"':  printf("\\\""); break;
-    case '\\': printf("\\\\"); break;
-    default:
-        if ((c > 0 && c < 32) || c == 0x7f) {
-            printf("\\u%04x", (unsigned int) c);
-        } else {
-            printf("%c", c);
-        }
-        break;
+    case '\b': fputs("\\b", stdout); break;
+    case '\f': fputs("\\f", stdout); break;
+    case '\n': fputs("\\n", stdout); break;
+    case '\r': fputs("\\r", stdout); break;
+    case '\t': fputs("\\t", stdout); break;
+    case '"':  fputs("\\\"", stdout); break;
+    case '\\': fputs("\\\\", stdout); break;
+    default:   printf("\\u%04x", (unsigned int) c); break;
     }
 }
 
-void PrintJSONString(char const *s)
+/***************************************************************/
+/*                                                             */
+/*  PrintJSONSpan                                              */
+/*                                                             */
+/*  Print len bytes of s as the inside of a JSON string.  Runs */
+/*  of characters that need no escaping go out in one fwrite() */
+/*  rather than a printf() apiece.                             */
+/*                                                             */
+/***************************************************************/
+static void PrintJSONSpan(char const *s, size_t len)
 {
-    while (*s) {
-        switch(*s) {
-        case '\b': printf("\\b"); break;
-        case '\f': printf("\\f"); break;
-        case '\n': printf("\\n"); break;
-        case '\r': printf("\\r"); break;
-        case '\t': printf("\\t"); break;
-        case '"':  printf("\\\""); break;
-        case '\\': printf("\\\\"); break;
-        default:
-            if ((*s > 0 && *s < 32) || *s == 0x7f) {
-                printf("\\u%04x", (unsigned int) *s);
-            } else {
-                printf("%c", *s);
-            }
-            break;
+    char const *end = s + len;
+    char const *run;
+
+    while (s < end) {
+        run = s;
+        while (s < end && !JSON_NEEDS_ESCAPE(*s)) s++;
+        if (s > run) {
+            fwrite(run, 1, (size_t) (s - run), stdout);
+        }
+        if (s < end) {
+            PrintJSONEscape(*s);
+            s++;
         }
-        s++;
     }
 }
 
+void PrintJSONString(char const *s)
+{
+    PrintJSONSpan(s, strlen(s));
+}
+
 static void PrintJSONStringLC(char const *s)
 {
+    char buf[256];
+    size_t n;
+
+    /* Lower-case in chunks so we can still write whole runs */
     while (*s) {
-        switch(*s) {
-        case '\b': printf("\\b"); break;
-        case '\f': printf("\\f"); break;
-        case '\n': printf("\\n"); break;
-        case '\r': printf("\\r"); break;
-        case '\t': printf("\\t"); break;
-        case '"':  printf("\\\""); break;
-        case '\\': printf("\\\\"); break;
-        default:
-            if ((*s > 0 && *s < 32) || *s == 0x7f) {
-                printf("\\u%04x", (unsigned int) *s);
-            } else {
-                printf("%c", tolower(*s));
-            }
-            break;
+        n = 0;
+        while (*s && n < sizeof(buf)) {
+            buf[n++] = tolower(*s);
+            s++;
         }
-        s++;
+        PrintJSONSpan(buf, n);
     }
 }
 
 void PrintJSONKeyPairInt(char const *name, int val)
 {
-    printf("\"");
+    putchar('"');
     PrintJSONString(name);
     printf("\":%d,", val);
 }
@@ -469,11 +477,11 @@ void PrintJSONKeyPairString(char const *name, char const *val)
         return;
     }
 
-    printf("\"");
+    putchar('"');
     PrintJSONString(name);
-    printf("\":\"");
+    fputs("\":\"", stdout);
     PrintJSONString(val);
-    printf("\",");
+    fputs("\",", stdout);
 }
 
 static void PrintJSONKeyPairDate(char const *name, int dse)
@@ -484,7 +492,7 @@ static void PrintJSONKeyPairDate(char const *name, int dse)
         return;
     }
     FromDSE(dse, &y, &m, &d);
-    printf("\"");
+    putchar('"');
     PrintJSONString(name);
     printf("\":\"%04d-%02d-%02d\",", y, m+1, d);
 
@@ -502,7 +510,7 @@ void PrintJSONKeyPairDateTime(char const *name, int dt)
     k = dt % MINUTES_PER_DAY;
     h = k / 60;
     i = k % 60;
-    printf("\"");
+    putchar('"');
     PrintJSONString(name);
     printf("\":\"%04d-%02d-%02dT%02d:%02d\",", y, m+1, d, h, i);
 
@@ -517,7 +525,7 @@ static void PrintJSONKeyPairTime(char const *name, int t)
     }
     h = t / 60;
     i = t % 60;
-    printf("\"");
+    putchar('"');
     PrintJSONString(name);
     printf("\":\"%02d:%02d\",", h, i);
 
@@ -849,6 +857,10 @@ void ProduceCalendar(void)
         FromDSE(DSEToday, &y, &m, &d);
         DSEToday = DSE(y, m, 1);
         LocalDSEToday = DSEToday;
+        m += CalMonths;
+        y += m / 12;
+        m %= 12;
+        CalLastDay = DSE(y, m, 1) - 1;
         LocalSysTime = 0;
         SysTime = 0;
         GenerateCalEntries(-1);
@@ -856,9 +868,13 @@ void ProduceCalendar(void)
         if (PsCal == PSCAL_LEVEL3) {
             printf("[\n");
         }
-        while (CalMonths--) {
-            DoCalendarOneMonth();
-            DidAMonth = 1;
+        if (CalWorkers > 1 && CalMonths > 1) {
+            DoCalendarMonthsInParallel();
+        } else {
+            while (CalMonths--) {
+                DoCalendarOneMonth();
+                DidAMonth = 1;
+            }
         }
         if (PsCal == PSCAL_LEVEL3) {
             printf("\n]\n");
@@ -872,6 +888,7 @@ void ProduceCalendar(void)
             DSEToday -= ((DSEToday+1)%7);
             LocalDSEToday -= ((LocalDSEToday+1)%7);
         }
+        CalLastDay = DSEToday + 7*CalWeeks - 1;
 
         LocalSysTime = 0;
         SysTime = 0;
@@ -1165,6 +1182,156 @@ static void DoSimpleCalendarOneMonth(void)
     }
 }
 
+/***************************************************************/
+/*                                                             */
+/*  DoMonthRange                                               */
+/*                                                             */
+/*  Produce count months starting first months after the       */
+/*  month containing start.                                    */
+/*                                                             */
+/***************************************************************/
+static void DoMonthRange(int start, int first, int count)
+{
+    int y, m, d;
+
+    FromDSE(start, &y, &m, &d);
+    m += first;
+    DSEToday = DSE(y + m / 12, m % 12, 1);
+    LocalDSEToday = DSEToday;
+    DidAMonth = (first > 0);
+    while (count--) {
+        DoCalendarOneMonth();
+        DidAMonth = 1;
+    }
+}
+
+static void CopyWorkerOutput(FILE *from, FILE *to)
+{
+    char buf[8192];
+    size_t n;
+
+    rewind(from);
+    while ((n = fread(buf, 1, sizeof(buf), from)) > 0) {
+        fwrite(buf, 1, n, to);
+    }
+    fclose(from);
+    fflush(to);
+}
+
+/* Wait for a worker to finish.  Returns 0, or -1 if we can't get its
+   exit status (if SIGCHLD was ignored when it exited, for example,
+   the system has already reaped it.) */
+static int WaitForWorker(pid_t pid, int *status)
+{
+    while (waitpid(pid, status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoCalendarMonthsInParallel                                 */
+/*                                                             */
+/*  Split CalMonths months among up to CalWorkers forked       */
+/*  processes, each running the script for its own contiguous  */
+/*  range of months into temporary files.  We copy their       */
+/*  output out in month order, so the result is the same as   */
+/*  doing the months one after another, provided the script    */
+/*  doesn't carry state from one day's run to the next.  If a  */
+/*  worker can't be started or waited for, we do its months    */
+/*  ourselves.                                                 */
+/*                                                             */
+/***************************************************************/
+static void DoCalendarMonthsInParallel(void)
+{
+    int nworkers = CalWorkers;
+    int start = DSEToday;
+    int i, j, first, count, status, other;
+    pid_t *pids;
+    FILE **outs, **errs;
+    struct sigaction sa, old_chld;
+
+    if (nworkers > CalMonths) nworkers = CalMonths;
+    pids = calloc(nworkers, sizeof(pid_t));
+    outs = calloc(nworkers, sizeof(FILE *));
+    errs = calloc(nworkers, sizeof(FILE *));
+    if (!pids || !outs || !errs) {
+        free(pids);
+        free(outs);
+        free(errs);
+        DoMonthRange(start, 0, CalMonths);
+        CalMonths = 0;
+        return;
+    }
+
+    /* Don't let the workers inherit anything still buffered */
+    fflush(stdout);
+    fflush(ErrFp);
+    fflush(stderr);
+
+    /* If we inherited an ignored SIGCHLD, the workers would be
+       reaped before we could collect their exit status */
+    sa.sa_handler = SIG_DFL;
+    sa.sa_flags = 0;
+    sigemptyset(&sa.sa_mask);
+    (void) sigaction(SIGCHLD, &sa, &old_chld);
+
+    for (i=0; i<nworkers; i++) {
+        pids[i] = -1;
+        outs[i] = tmpfile();
+        errs[i] = tmpfile();
+        if (!outs[i] || !errs[i]) {
+            continue;
+        }
+        first = (int) ((long) CalMonths * i / nworkers);
+        count = (int) ((long) CalMonths * (i+1) / nworkers) - first;
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            dup2(fileno(outs[i]), STDOUT_FILENO);
+            dup2(fileno(errs[i]), STDERR_FILENO);
+            DoMonthRange(start, first, count);
+            fflush(stdout);
+            fflush(stderr);
+            _exit(EXIT_SUCCESS);
+        }
+    }
+
+    for (i=0; i<nworkers; i++) {
+        first = (int) ((long) CalMonths * i / nworkers);
+        count = (int) ((long) CalMonths * (i+1) / nworkers) - first;
+        status = 0;
+        if (pids[i] > 0 && WaitForWorker(pids[i], &status) < 0) {
+            /* We can't tell whether it finished; do it over */
+            pids[i] = -1;
+        }
+        if (pids[i] < 0) {
+            if (outs[i]) fclose(outs[i]);
+            if (errs[i]) fclose(errs[i]);
+            DoMonthRange(start, first, count);
+            fflush(stdout);
+            continue;
+        }
+        CopyWorkerOutput(errs[i], stderr);
+        CopyWorkerOutput(outs[i], stdout);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            /* The worker bailed out, just as we would have; stop here */
+            for (j=i+1; j<nworkers; j++) {
+                if (pids[j] > 0) {
+                    kill(pids[j], SIGTERM);
+                    (void) WaitForWorker(pids[j], &other);
+                }
+            }
+            exit(WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE);
+        }
+    }
+    (void) sigaction(SIGCHLD, &old_chld, NULL);
+    free(pids);
+    free(outs);
+    free(errs);
+    CalMonths = 0;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  DoCalendarOneMonth                                         */
@@ -1926,6 +2093,7 @@ static int DoCalRem(ParsePtr p, int col)
     DynamicBuffer buf, obuf, pre_buf, raw_buf;
     Token tok;
     int nonconst_expr = 0;
+    CompiledRem **compiled = NULL;
 
     int is_color, col_r, col_g, col_b;
 
@@ -1935,15 +2103,18 @@ static int DoCalRem(ParsePtr p, int col)
         CurCol = NULL;
     }
     is_color = 0;
-    DBufInit(&buf);
-    DBufInit(&pre_buf);
-    DBufInit(&raw_buf);
+    DBufInitTemp(&buf);
+    DBufInitTemp(&pre_buf);
+    DBufInitTemp(&raw_buf);
 
     /* Parse the trigger date and time */
-    if ( (r=ParseRem(p, &trig, &tim)) ) {
+    if ( (r=ParseRemCompiled(p, &trig, &tim)) ) {
         FreeTrig(&trig);
         return r;
     }
+    if (CompileCalendar) {
+        compiled = CurrentCompiledRem();
+    }
 
     if (trig.tz != NULL && tim.ttime == NO_TIME) {
         FreeTrig(&trig);
@@ -2051,7 +2222,13 @@ static int DoCalRem(ParsePtr p, int col)
     } else {
         /* Calculate the trigger date */
         EnterTimezone(trig.tz);
-        dse = ComputeTrigger(get_scanfrom(&trig), &trig, &tim, &r, 1);
+        if (compiled && *compiled) {
+            /* Find the trigger dates once for the whole calendar */
+            dse = ComputeTriggerFromDates(get_scanfrom(&trig), CalLastDay,
+                                          &trig, &tim, &((*compiled)->dates), &r);
+        } else {
+            dse = ComputeTrigger(get_scanfrom(&trig), &trig, &tim, &r, 1);
+        }
         ExitTimezone(trig.tz);
         if (r) {
             if (r == E_CANT_TRIG && trig.maybe_uncomputable) {
@@ -2126,7 +2303,7 @@ static int DoCalRem(ParsePtr p, int col)
         if (!strcasecmp(trig.passthru, "SHADE") && dse == DSEToday) {
             Shaded++;
             if (!PsCal) {
-                DBufInit(&obuf);
+                DBufInitTemp(&obuf);
                 r = DoSubst(p, &obuf, &trig, &tim, dse, CAL_MODE);
                 if (r) {
                     DBufFree(&obuf);
@@ -2139,7 +2316,7 @@ static int DoCalRem(ParsePtr p, int col)
         }
         if (!PsCal && !strcasecmp(trig.passthru, "WEEK")) {
             if (dse == DSEToday) {
-                DBufInit(&obuf);
+                DBufInitTemp(&obuf);
                 r = DoSubst(p, &obuf, &trig, &tim, dse, CAL_MODE);
                 if (r) {
                     DBufFree(&obuf);
@@ -2156,7 +2333,7 @@ static int DoCalRem(ParsePtr p, int col)
         }
         if (!PsCal && !strcasecmp(trig.passthru, "MOON")) {
             if (dse == DSEToday) {
-                DBufInit(&obuf);
+                DBufInitTemp(&obuf);
                 r = DoSubst(p, &obuf, &trig, &tim, dse, CAL_MODE);
                 if (r) {
                     DBufFree(&obuf);
@@ -2215,7 +2392,7 @@ static int DoCalRem(ParsePtr p, int col)
     }
 
     /* If trigger date == today, add it to the current entry */
-    DBufInit(&obuf);
+    DBufInitTemp(&obuf);
     if ((dse == DSEToday) ||
         (DoSimpleCalDelta &&
          ShouldTriggerReminder(&trig, &tim, dse, &err))) {
@@ -2631,7 +2808,7 @@ void WriteJSONTrigger(Trigger const *t, int include_tags)
 
 static void WriteSimpleEntryProtocol2(CalEntry *e)
 {
-    char const *s;
+    char const *s, *t;
     if (DoPrefixLineNo) {
         PrintJSONKeyPairString("filename", e->filename);
         PrintJSONKeyPairInt("lineno", e->lineno);
@@ -2699,13 +2876,8 @@ static void WriteSimpleEntryProtocol2(CalEntry *e)
         if (s) {
             s += 2;
             printf("\"calendar_body\":\"");
-            while (*s) {
-                if (*s == '%' && *(s+1) == '"') {
-                    break;
-                }
-                PrintJSONChar(*s);
-                s++;
-            }
+            t = strstr(s, "%\"");
+            PrintJSONSpan(s, t ? (size_t) (t - s) : strlen(s));
             printf("\",");
         }
     }
@@ -2721,14 +2893,11 @@ static void WriteSimpleEntryProtocol2(CalEntry *e)
             while(*s && !isspace(*s)) s++;
             while(*s && isspace(*s)) s++;
         }
-        while(*s) {
-            if (*s == '%' && *(s+1) == '"') {
-                s += 2;
-                continue;
-            }
-            PrintJSONChar(*s);
-            s++;
+        while((t = strstr(s, "%\"")) != NULL) {
+            PrintJSONSpan(s, (size_t) (t - s));
+            s = t + 2;
         }
+        PrintJSONString(s);
         printf("\",");
     }
     printf("\"body\":\"");
@@ -113,11 +113,6 @@
 /*---------------------------------------------------------------------*/
 #define TRIG_ATTEMPTS 500
 
-/*---------------------------------------------------------------------*/
-/* How many global omits of the form YYYY MM DD do we handle?          */
-/*---------------------------------------------------------------------*/
-#define MAX_FULL_OMITS 1000
-
 /*---------------------------------------------------------------------*/
 /* How many global omits of the form MM DD do we handle?               */
 /*---------------------------------------------------------------------*/
@@ -87,7 +87,7 @@ void ExitTimezone(char const *tz)
         return;
     }
     /* Revert to our local time zone */
-    (void) tz_set_tz(LocalTimeZone);
+    tz_set_active(LocalTimeZone);
 
     DSEToday = LocalDSEToday;
     SysTime = LocalSysTime;
@@ -126,17 +126,17 @@ void EnterTimezone(char const *tz)
     tm.tm_mday  = d;
     tm.tm_mon   = m;
     tm.tm_year  = y - 1900;
-    tm.tm_wday  = 0;  /* Ignored by mktime */
-    tm.tm_yday  = 0;  /* Ignored by mktime */
+    tm.tm_wday  = 0;  /* Ignored by tz_mktime */
+    tm.tm_yday  = 0;  /* Ignored by tz_mktime */
     tm.tm_isdst = -1; /* Information not available */
 
-    t = mktime(&tm);    /* Convert local time to seconds */
+    t = tz_mktime(&tm);    /* Convert local time to seconds */
 
     /* Set target timezone */
-    (void) tz_set_tz(tz);
+    tz_set_active(tz);
 
     /* Update our variables */
-    (void) localtime_r(&t, &tm);
+    (void) tz_localtime_r(&t, &tm);
 
     SysTime  = tm.tm_min * 60 + (tm.tm_hour * 3600);
     CurDay   = tm.tm_mday;
@@ -405,7 +405,7 @@ int DoRem(ParsePtr p)
     DynamicBuffer buf;
     Token tok;
 
-    DBufInit(&buf);
+    DBufInitTemp(&buf);
 
     /* Parse the trigger date and time */
     if ( (r=ParseRem(p, &trig, &tim)) != OK ) {
@@ -589,7 +589,7 @@ int DoRem(ParsePtr p)
             DynamicBuffer body;
             int y, m, d;
             int if_depth = get_if_pointer() - get_base_if_pointer();
-            DBufInit(&body);
+            DBufInitTemp(&body);
             int red=-1, green=-1, blue=-1;
             r=TriggerReminder(p, &trig, &tim, dse, 0, &body, &red, &green, &blue);
             if (r) {
@@ -811,7 +811,7 @@ int ParseRem(ParsePtr s, Trigger *trig, TimeTrig *tim)
     trig->eventstart_orig = NO_DATETIME;
     trig->eventduration = NO_TIME;
     trig->maybe_uncomputable = 0;
-    DBufInit(&(trig->tags));
+    DBufInitTemp(&(trig->tags));
     trig->passthru[0] = 0;
     tim->ttime = NO_TIME;
     tim->ttime_orig = NO_TIME;
@@ -1288,6 +1288,109 @@ int ParseRem(ParsePtr s, Trigger *trig, TimeTrig *tim)
     return OK;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  ParseRemCompiled                                           */
+/*                                                             */
+/*  Like ParseRem, but if --compile-calendar is in effect and  */
+/*  the line came from the file cache, a REM whose trigger     */
+/*  contains no non-constant expressions is parsed only once.  */
+/*  On subsequent calendar days, the compiled trigger is       */
+/*  copied out and the parser is positioned at the start of    */
+/*  the body, ready for DoSubst.                               */
+/*                                                             */
+/***************************************************************/
+int ParseRemCompiled(ParsePtr s, Trigger *trig, TimeTrig *tim)
+{
+    CompiledRem **slot = NULL;
+    CompiledRem *c;
+    int r;
+    int warnings = NumWarnings;
+
+    if (CompileCalendar) {
+        slot = CurrentCompiledRem();
+    }
+    if (slot && *slot) {
+        c = *slot;
+        if (c->text == s->text &&
+            c->default_prio == DefaultPrio &&
+            c->default_delta == DefaultDelta &&
+            c->default_tdelta == DefaultTDelta) {
+            r = CopyTrigger(trig, &(c->trig));
+            if (r) return r;
+            *tim = c->tim;
+            s->pos = s->text + c->body_offset;
+            s->expr_happened = c->trig.expr_happened;
+            if (c->pushed) {
+                DBufFree(&s->pushedToken);
+                if (DBufPuts(&s->pushedToken, c->pushed) != OK) {
+                    return E_NO_MEM;
+                }
+                s->tokenPushed = DBufValue(&s->pushedToken);
+            }
+            return OK;
+        }
+        /* Stale; recompile */
+        FreeCompiledRem(c);
+        *slot = NULL;
+    }
+
+    r = ParseRem(s, trig, tim);
+    if (r || !slot) {
+        return r;
+    }
+
+    /* Only compile if the trigger is the same every day, and we
+       are not in the middle of a pasted [expression].  If parsing
+       produced warnings, they have to be issued every day too. */
+    if (trig->nonconst_expr || trig->typ == SAT_TYPE || s->isnested ||
+        NumWarnings != warnings) {
+        return OK;
+    }
+
+    c = NEW(CompiledRem);
+    if (!c) {
+        return OK;
+    }
+    c->text = s->text;
+    c->body_offset = (int) (s->pos - s->text);
+    c->pushed = NULL;
+    c->default_prio = DefaultPrio;
+    c->default_delta = DefaultDelta;
+    c->default_tdelta = DefaultTDelta;
+    c->tim = *tim;
+    c->dates.dates = NULL;
+    FreeTriggerDates(&(c->dates));
+    if (CopyTrigger(&(c->trig), trig) != OK) {
+        FreeCompiledRem(c);
+        return OK;
+    }
+    if (s->tokenPushed && *s->tokenPushed) {
+        c->pushed = strdup(s->tokenPushed);
+        if (!c->pushed) {
+            FreeCompiledRem(c);
+            return OK;
+        }
+    }
+    *slot = c;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FreeCompiledRem                                            */
+/*                                                             */
+/***************************************************************/
+void FreeCompiledRem(CompiledRem *c)
+{
+    FreeTrig(&(c->trig));
+    FreeTriggerDates(&(c->dates));
+    if (c->pushed) {
+        free(c->pushed);
+    }
+    free(c);
+}
+
 /***************************************************************/
 /*                                                             */
 /*  ParseTimeTrig - parse the AT part of a timed reminder      */
@@ -1570,9 +1673,9 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig const *tim, int dse, int is
     int red = -1, green = -1, blue = -1;
     int is_color = 0;
 
-    DBufInit(&buf);
-    DBufInit(&calRow);
-    DBufInit(&pre_buf);
+    DBufInitTemp(&buf);
+    DBufInitTemp(&calRow);
+    DBufInitTemp(&pre_buf);
     if (t->typ == RUN_TYPE && RunDisabled) return E_RUN_DISABLED;
     if ((t->typ == PASSTHRU_TYPE && strcasecmp(t->passthru, "COLOR") && strcasecmp(t->passthru, "COLOUR")) ||
         t->typ == CAL_TYPE ||
@@ -1620,7 +1723,7 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig const *tim, int dse, int is
     if ((t->typ == MSG_TYPE || t->typ == MSF_TYPE) 
         && !DidMsgReminder && !NextMode && !msg_command && !is_queued) {
         DynamicBuffer buf2;
-        DBufInit(&buf2);
+        DBufInitTemp(&buf2);
         DidMsgReminder = 1;
         if (!DoSubstFromString(DBufValue(&Banner), &buf2,
                                DSEToday, NO_TIME) &&
@@ -1983,6 +2086,11 @@ int ShouldTriggerReminder(Trigger const *t, TimeTrig const *tim, int dse, int *e
             int max = MaxSatIter;
             r = t->delta;
             if (max < r*2) max = r*2;
+            if (!*t->omitfunc && dse - DSEToday <= max) {
+                /* No OMITFUNC:  Count the working days in one go */
+                return (dse <= DSEToday ||
+                        CountNonOmitted(DSEToday+1, dse, t->localomit) < r);
+            }
             while(iter++ < max) {
                 if (!r || (dse <= DSEToday)) {
                     break;
@@ -2277,6 +2385,14 @@ static int ShouldTriggerBasedOnWarn(Trigger const *t, int dse, int *err)
             int iter = 0;
             int max = MaxSatIter;
             if (max < v.v.val * 2) max = v.v.val*2;
+            if (!*t->omitfunc) {
+                j = SlideNonOmitted(dse, v.v.val, t->localomit, max+1);
+                if (j >= 0) {
+                    if (j == DSEToday) return 1;
+                    continue;
+                }
+                j = dse;
+            }
             while(iter++ <= max) {
                 j--;
                 *err = IsOmitted(j, t->localomit, t->omitfunc, &omit);
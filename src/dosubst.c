@@ -272,7 +272,7 @@ int DoSubst(ParsePtr p, DynamicBuffer *dbuf, Trigger *t, TimeTrig const *tt, int
         if (c == '<') {
             DynamicBuffer header;
             char const *val;
-            DBufInit(&header);
+            DBufInitTemp(&header);
 
             while(1) {
                 c = ParseChar(p, &err, 0);
@@ -299,8 +299,8 @@ int DoSubst(ParsePtr p, DynamicBuffer *dbuf, Trigger *t, TimeTrig const *tt, int
         if (c == '(') {
             DynamicBuffer orig;
             DynamicBuffer translated;
-            DBufInit(&orig);
-            DBufInit(&translated);
+            DBufInitTemp(&orig);
+            DBufInitTemp(&translated);
             while(1) {
                 c = ParseChar(p, &err, 0);
                 if (err) {
@@ -20,10 +20,61 @@
 static size_t NumMallocs = 0;
 static size_t BytesMalloced = 0;
 
-void DBufGetMallocStats(size_t *num_mallocs, size_t *bytes_malloced)
+/* Scratch arena for temporary buffers.  Blocks are handed out from
+   the top like a stack; freeing the top block pops it, and the whole
+   arena is rewound once no block is in use.  Requests that do not fit
+   fall back to malloc. */
+#define DBUF_ARENA_SIZE 65536
+static char *Arena = NULL;
+static size_t ArenaUsed = 0;
+static size_t ArenaLive = 0;
+static size_t ArenaAllocs = 0;
+static size_t ArenaHighWater = 0;
+
+#define IN_ARENA(p) (Arena && (p) >= Arena && (p) < Arena + DBUF_ARENA_SIZE)
+#define ON_ARENA_TOP(dbuf) ((dbuf)->buffer + (dbuf)->allocatedLen == Arena + ArenaUsed)
+
+void DBufGetMallocStats(size_t *num_mallocs, size_t *bytes_malloced,
+                        size_t *arena_allocs, size_t *arena_high_water)
 {
     *num_mallocs = NumMallocs;
     *bytes_malloced = BytesMalloced;
+    *arena_allocs = ArenaAllocs;
+    *arena_high_water = ArenaHighWater;
+}
+
+static void ArenaGrow(size_t n)
+{
+    ArenaUsed += n;
+    if (ArenaUsed > ArenaHighWater) ArenaHighWater = ArenaUsed;
+}
+
+static char *ArenaAlloc(size_t size)
+{
+    char *buf;
+
+    if (!Arena) {
+        Arena = malloc(DBUF_ARENA_SIZE);
+        if (!Arena) return NULL;
+    }
+    if (size > DBUF_ARENA_SIZE - ArenaUsed) return NULL;
+    buf = Arena + ArenaUsed;
+    ArenaGrow(size);
+    ArenaLive++;
+    ArenaAllocs++;
+    return buf;
+}
+
+/* Release whatever memory dbuf holds, without reinitializing it */
+static void DBufRelease(DynamicBuffer *dbuf)
+{
+    if (dbuf->buffer == NULL || dbuf->buffer == dbuf->staticBuf) return;
+    if (!IN_ARENA(dbuf->buffer)) {
+        free(dbuf->buffer);
+        return;
+    }
+    if (ON_ARENA_TOP(dbuf)) ArenaUsed -= dbuf->allocatedLen;
+    if (!--ArenaLive) ArenaUsed = 0;
 }
 
 /**********************************************************************
@@ -50,18 +101,29 @@ static int DBufMakeRoom(DynamicBuffer *dbuf, size_t n)
         size *= 2;
     }
 
+    /* The topmost arena block can simply be extended */
+    if (dbuf->temp && IN_ARENA(dbuf->buffer) && ON_ARENA_TOP(dbuf) &&
+        size - dbuf->allocatedLen <= DBUF_ARENA_SIZE - ArenaUsed) {
+        ArenaGrow(size - dbuf->allocatedLen);
+        dbuf->allocatedLen = size;
+        return OK;
+    }
+
     /* Allocate memory */
-    buf = malloc(size);
-    if (!buf) return E_NO_MEM;
+    buf = dbuf->temp ? ArenaAlloc(size) : NULL;
+    if (!buf) {
+        buf = malloc(size);
+        if (!buf) return E_NO_MEM;
 
-    NumMallocs++;
-    BytesMalloced += size;
+        NumMallocs++;
+        BytesMalloced += size;
+    }
 
     /* Copy contents */
     strcpy(buf, dbuf->buffer);
 
     /* Free contents if necessary */
-    if (dbuf->buffer != dbuf->staticBuf) free(dbuf->buffer);
+    DBufRelease(dbuf);
     dbuf->buffer = buf;
     dbuf->allocatedLen = size;
     return OK;
@@ -82,6 +144,24 @@ void DBufInit(DynamicBuffer *dbuf)
     dbuf->len = 0;
     dbuf->allocatedLen = DBUF_STATIC_SIZE;
     dbuf->buffer[0] = 0;
+    dbuf->temp = 0;
+}
+
+/**********************************************************************
+%FUNCTION: DBufInitTemp
+%ARGUMENTS:
+ dbuf -- pointer to a dynamic buffer
+%RETURNS:
+ Nothing
+%DESCRIPTION:
+ Initializes a dynamic buffer that grows in the scratch arena rather
+ than with malloc.  Meant for per-line temporaries; the buffer should
+ be freed before the line is done so the arena can be rewound.
+**********************************************************************/
+void DBufInitTemp(DynamicBuffer *dbuf)
+{
+    DBufInit(dbuf);
+    dbuf->temp = 1;
 }
 
 /**********************************************************************
@@ -136,10 +216,11 @@ int DBufPuts(DynamicBuffer *dbuf, char const *str)
 **********************************************************************/
 void DBufFree(DynamicBuffer *dbuf)
 {
-    if (dbuf->buffer != NULL && dbuf->buffer != dbuf->staticBuf) {
-        free(dbuf->buffer);
-    }
+    int temp = dbuf->temp;
+
+    DBufRelease(dbuf);
     DBufInit(dbuf);
+    dbuf->temp = temp;
 }
 
 /**********************************************************************
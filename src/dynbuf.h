@@ -21,15 +21,18 @@ typedef struct {
     size_t len;
     size_t allocatedLen;
     char staticBuf[DBUF_STATIC_SIZE];
+    int temp;  /* Grows in the scratch arena; see DBufInitTemp */
 } DynamicBuffer;
 
 void DBufInit(DynamicBuffer *dbuf);
+void DBufInitTemp(DynamicBuffer *dbuf);
 int DBufPutcFN(DynamicBuffer *dbuf, char c);
 int DBufPuts(DynamicBuffer *dbuf, char const *str);
 void DBufFree(DynamicBuffer *dbuf);
 int DBufGets(DynamicBuffer *dbuf, FILE *fp);
 
-void DBufGetMallocStats(size_t *num_mallocs, size_t *bytes_malloced);
+void DBufGetMallocStats(size_t *num_mallocs, size_t *bytes_malloced,
+                        size_t *arena_allocs, size_t *arena_high_water);
 
 #define DBufValue(bufPtr) ((bufPtr)->buffer)
 #define DBufLen(bufPtr) ((bufPtr)->len)
@@ -213,7 +213,7 @@ EXTERN char *ErrMsg[]
 /* E_UNKNOWN_TOKEN */     "Unknown token",
 /* E_SPEC_MON */          "Must specify month in OMIT command",
 /* E_TODO_TWICE */        "TODO specified twice",
-/* E_2MANY_FULL */        "Too many full OMITs (max. " STR(MAX_FULL_OMITS) ")",
+/* E_2MANY_FULL */        "Too many full OMITs",
 /* E_PUSH_NOPOP */        "Warning: PUSH-OMIT-CONTEXT without matching POP-OMIT-CONTEXT",
 /* E_ERR_READING */       "Error reading",
 /* E_EXPECTING_EOL */     "Expecting end-of-line",
@@ -22,9 +22,11 @@
 #include "protos.h"
 #include "globals.h"
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdarg.h>
 #include <unistd.h>
+#include <time.h>
 
 /*
   The parser parses expressions into an internal tree
@@ -303,6 +305,7 @@ alloc_expr_node(int *r)
     node->child = NULL;
     node->sibling = NULL;
     node->num_kids = 0;
+    node->bound = NULL;
     return node;
 }
 
@@ -429,6 +432,55 @@ debug_evaluation_unop(Value const *ans, int r, Value const *v1, char const *fmt,
     va_end(argptr);
 }
 
+/***************************************************************/
+/*                                                             */
+/* bound_var - find the global variable named by `node'        */
+/*                                                             */
+/* The lookup is remembered in the node and reused until a     */
+/* variable is deleted.  Misses are not remembered, since the  */
+/* variable may be SET later.                                  */
+/*                                                             */
+/***************************************************************/
+static Var *
+bound_var(expr_node *node)
+{
+    Var *v;
+
+    if (node->bound && node->bound_gen == VarBindGeneration) {
+        return (Var *) node->bound;
+    }
+    v = FindVar(node_str(node), 0);
+    if (v) {
+        node->bound = v;
+        node->bound_gen = VarBindGeneration;
+    }
+    return v;
+}
+
+/***************************************************************/
+/*                                                             */
+/* bound_userfunc - find the user function named by `node'     */
+/*                                                             */
+/* As bound_var, but revalidated against FuncGeneration.       */
+/*                                                             */
+/***************************************************************/
+static UserFunc *
+bound_userfunc(expr_node *node, char const *fname)
+{
+    UserFunc *f;
+
+    if (node->bound && node->bound_gen == FuncGeneration) {
+        DepRead('f', fname);
+        return (UserFunc *) node->bound;
+    }
+    f = FindUserFunc(fname);
+    if (f) {
+        node->bound = f;
+        node->bound_gen = FuncGeneration;
+    }
+    return f;
+}
+
 /***************************************************************/
 /*                                                             */
 /* get_var - get the value of a variable                       */
@@ -444,7 +496,8 @@ get_var(expr_node *node, Value *ans, int *nonconst)
     char const *str;
 
     str = node_str(node);
-    v = FindVar(str, 0);
+    DepRead('v', str);
+    v = bound_var(node);
     if (!v) {
         Eprint("%s: `%s'", GetErr(E_NOSUCH_VAR), str);
         return E_NOSUCH_VAR;
@@ -497,6 +550,8 @@ eval_builtin(expr_node *node, Value *locals, Value *ans, int *nonconst)
         return E_RECURSIVE;
     }
 
+    DepNoteBuiltin(f->name);
+
     /* If this is a new-style function that knows about expr_nodes,
        let it evaluate itself */
     if (f->newfunc) {
@@ -699,7 +754,7 @@ eval_userfunc(expr_node *node, Value *locals, Value *ans, int *nonconst)
     char const *fname = node_str(node);
 
     /* Find the function */
-    f = FindUserFunc(fname);
+    f = bound_userfunc(node, fname);
 
     /* Bail if function does not exist */
     if (!f) {
@@ -805,6 +860,37 @@ eval_userfunc(expr_node *node, Value *locals, Value *ans, int *nonconst)
     return r;
 }
 
+/* $ExpressionTimeLimit is enforced by checking the clock against a
+   deadline once every TIME_CHECK_NODES node evaluations */
+#define TIME_CHECK_NODES 256
+
+static int TimeLimitDepth = 0;
+static int TimeLimitActive = 0;
+static int NodesUntilTimeCheck = 0;
+static struct timespec TimeLimitDeadline;
+
+static void
+get_monotonic_time(struct timespec *ts)
+{
+#ifdef CLOCK_MONOTONIC
+    if (!clock_gettime(CLOCK_MONOTONIC, ts)) return;
+#endif
+    ts->tv_sec = time(NULL);
+    ts->tv_nsec = 0;
+}
+
+static int
+time_limit_exceeded(void)
+{
+    struct timespec now;
+
+    get_monotonic_time(&now);
+    if (now.tv_sec != TimeLimitDeadline.tv_sec) {
+        return now.tv_sec > TimeLimitDeadline.tv_sec;
+    }
+    return now.tv_nsec >= TimeLimitDeadline.tv_nsec;
+}
+
 /***************************************************************/
 /*                                                             */
 /* evaluate_expression - evaluate an expression, possibly      */
@@ -818,29 +904,34 @@ int
 evaluate_expression(expr_node *node, Value *locals, Value *ans, int *nonconst)
 {
     int r;
+    int timed = 0;
 
-    /* Set up time limits */
+    /* Set up time limits.  Expressions evaluated while evaluating
+       another one count against the outer expression's deadline */
     if (ExpressionEvaluationTimeLimit > 0) {
-        ExpressionTimeLimitExceeded = 0;
-        alarm(ExpressionEvaluationTimeLimit);
+        if (!TimeLimitDepth) {
+            get_monotonic_time(&TimeLimitDeadline);
+            TimeLimitDeadline.tv_sec += ExpressionEvaluationTimeLimit;
+            TimeLimitActive = 1;
+            NodesUntilTimeCheck = TIME_CHECK_NODES;
+        }
+        TimeLimitDepth++;
+        timed = 1;
     }
     r = evaluate_expr_node(node, locals, ans, nonconst);
-    if (ExpressionEvaluationTimeLimit > 0) {
-        alarm(0);
-        ExpressionTimeLimitExceeded = 0;
+    if (timed && !--TimeLimitDepth) {
+        TimeLimitActive = 0;
     }
     return r;
 }
 
 static int CopyShortStr(Value *ans, expr_node const *node)
 {
-    size_t len = strlen(node->u.name);
-    ans->v.str = malloc(len+1);
+    ans->v.str = DupStr(node->u.name);
     if (!ans->v.str) {
         ans->type = ERR_TYPE;
         return E_NO_MEM;
     }
-    strcpy(ans->v.str, node->u.name);
     ans->type = STR_TYPE;
     return OK;
 }
@@ -872,9 +963,13 @@ evaluate_expr_node(expr_node *node, Value *locals, Value *ans, int *nonconst)
         return E_EXPR_DISABLED;
     }
 
-    if (ExpressionTimeLimitExceeded) {
-        ExpressionTimeLimitExceeded = 0;
-        return E_TIME_EXCEEDED;
+    if (TimeLimitActive && --NodesUntilTimeCheck <= 0) {
+        NodesUntilTimeCheck = TIME_CHECK_NODES;
+        if (time_limit_exceeded()) {
+            /* Only fail once; the error propagates up from here */
+            TimeLimitActive = 0;
+            return E_TIME_EXCEEDED;
+        }
     }
     if (!node) {
         return E_SWERR;
@@ -1201,7 +1296,7 @@ static int add(expr_node *node, Value *locals, Value *ans, int *nonconst)
             DestroyValue(v2);
             return E_STRING_TOO_LONG;
         }
-        ans->v.str = malloc(l1 + l2 + 1);
+        ans->v.str = AllocStr(l1 + l2);
         if (!ans->v.str) {
             DBG(debug_evaluation_binop(ans, E_NO_MEM, &o1, &o2, "+"));
             DestroyValue(v1);
@@ -1365,14 +1460,13 @@ static int multiply(expr_node *node, Value *locals, Value *ans, int *nonconst)
         if (rep == 0 || !str || !*str) {
             /* Empty string */
             ans->type = STR_TYPE;
-            ans->v.str = malloc(1);
+            ans->v.str = DupStr("");
             if (!ans->v.str) {
                 DBG(debug_evaluation_binop(ans, E_NO_MEM, &v1, &v2, "*"));
                 DestroyValue(v1);
                 DestroyValue(v2);
                 return E_NO_MEM;
             }
-            *ans->v.str = 0;
             DBG(debug_evaluation_binop(ans, OK, &v1, &v2, "*"));
             DestroyValue(v1); DestroyValue(v2);
             return OK;
@@ -1396,7 +1490,7 @@ static int multiply(expr_node *node, Value *locals, Value *ans, int *nonconst)
             return E_STRING_TOO_LONG;
         }
         ans->type = STR_TYPE;
-        ans->v.str = malloc(l * rep + 1);
+        ans->v.str = AllocStr(l * rep);
         if (!ans->v.str) {
             DBG(debug_evaluation_binop(ans, E_NO_MEM, &v1, &v2, "*"));
             DestroyValue(v1); DestroyValue(v2);
@@ -1917,7 +2011,7 @@ static int set_long_name(expr_node *node, char const *s)
     char *buf;
     size_t len = strlen(s);
     if (len > VAR_NAME_LEN) len = VAR_NAME_LEN;
-    buf = malloc(len+1);
+    buf = AllocStr(len);
     if (!buf) {
         return E_NO_MEM;
     }
@@ -2083,7 +2177,7 @@ static int set_constant_value(expr_node *atom)
             return OK;
         }
         atom->u.value.type = STR_TYPE;
-        atom->u.value.v.str = malloc(len);
+        atom->u.value.v.str = AllocStr(len-1);
         if (! atom->u.value.v.str) {
             atom->u.value.type = ERR_TYPE;
             return E_NO_MEM;
@@ -2983,7 +3077,7 @@ static char const *truncate_string(char const *src)
 /*  Print or stringify a value for debugging purposes.         */
 /*                                                             */
 /***************************************************************/
-static DynamicBuffer printbuf = {NULL, 0, 0, ""};
+static DynamicBuffer printbuf = {NULL, 0, 0, "", 0};
 
 #define PV_PUTC(fp, c) do { if (fp) { putc((c), fp); } else { DBufPutc(&printbuf, (c)); } } while(0);
 
@@ -3090,19 +3184,159 @@ char const *PrintValue (Value const *v, FILE *fp)
     }
 }
 
+/***************************************************************/
+/*                                                             */
+/*  String values                                              */
+/*                                                             */
+/*  The string in a STR_TYPE Value is immutable and reference- */
+/*  counted, so CopyValue need only bump the count.  The count */
+/*  lives in a header just before the characters.  Strings of  */
+/*  zero or one character come from a static table and are    */
+/*  never freed; their count is left at zero.                  */
+/*                                                             */
+/***************************************************************/
+typedef struct {
+    unsigned int refs;
+    char data[2];
+} StrHeader;
+
+#define STR_HEADER(s) ((StrHeader *) ((s) - offsetof(StrHeader, data)))
+
+static StrHeader SmallStrs[256];
+static int SmallStrsInitialized = 0;
+
+static unsigned long StrsAllocated = 0;
+static unsigned long StrsShared = 0;
+static unsigned long StrsSmall = 0;
+static unsigned long StrsLive = 0;
+static unsigned long StrsHighWater = 0;
+
+/***************************************************************/
+/*                                                             */
+/*  AllocStr                                                   */
+/*                                                             */
+/*  Allocate a private, writable string with room for len      */
+/*  characters plus the terminating NUL.  The caller must fill */
+/*  it in before the Value holding it is copied.               */
+/*                                                             */
+/***************************************************************/
+char *AllocStr(size_t len)
+{
+    StrHeader *h = malloc(sizeof(StrHeader) + len);
+    if (!h) return NULL;
+    h->refs = 1;
+    h->data[0] = 0;
+    StrsAllocated++;
+    StrsLive++;
+    if (StrsLive > StrsHighWater) StrsHighWater = StrsLive;
+    return h->data;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DupStr                                                     */
+/*                                                             */
+/*  Return an immutable string value with the contents of s.   */
+/*  The result must not be modified; use MakeStrUnique first.  */
+/*                                                             */
+/***************************************************************/
+char *DupStr(char const *s)
+{
+    char *d;
+    size_t len;
+
+    if (!s[0] || !s[1]) {
+        unsigned char c = (unsigned char) s[0];
+        if (!SmallStrsInitialized) {
+            int i;
+            for (i=0; i<256; i++) {
+                SmallStrs[i].data[0] = (char) i;
+                SmallStrs[i].data[1] = 0;
+            }
+            SmallStrsInitialized = 1;
+        }
+        StrsSmall++;
+        return SmallStrs[c].data;
+    }
+    len = strlen(s);
+    d = AllocStr(len);
+    if (!d) return NULL;
+    memcpy(d, s, len+1);
+    return d;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ReleaseStr                                                 */
+/*                                                             */
+/*  Drop a reference to a string value, freeing it when the    */
+/*  last reference goes away.                                  */
+/*                                                             */
+/***************************************************************/
+void ReleaseStr(char *s)
+{
+    StrHeader *h = STR_HEADER(s);
+    if (!h->refs) return;
+    if (--h->refs) return;
+    StrsLive--;
+    free(h);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  MakeStrUnique                                              */
+/*                                                             */
+/*  Make sure the string in v is not shared with any other     */
+/*  Value so it can be modified in place.                      */
+/*                                                             */
+/***************************************************************/
+int MakeStrUnique(Value *v)
+{
+    char *s;
+    size_t len;
+
+    if (v->type != STR_TYPE || STR_HEADER(v->v.str)->refs == 1) {
+        return OK;
+    }
+    len = strlen(v->v.str);
+    s = AllocStr(len);
+    if (!s) return E_NO_MEM;
+    memcpy(s, v->v.str, len+1);
+    ReleaseStr(v->v.str);
+    v->v.str = s;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  print_str_stats - print statistics about string values     */
+/*                                                             */
+/***************************************************************/
+void print_str_stats(void)
+{
+    fprintf(ErrFp, "String values allocated: %lu; shared: %lu; small: %lu\n",
+            StrsAllocated, StrsShared, StrsSmall);
+    fprintf(ErrFp, "String values high-water: %lu; live: %lu\n",
+            StrsHighWater, StrsLive);
+}
+
 /***************************************************************/
 /*                                                             */
 /*  CopyValue                                                  */
 /*                                                             */
-/*  Copy a value.  If value is a string, strdups the string.   */
+/*  Copy a value.  If value is a string, shares the string.    */
 /*                                                             */
 /***************************************************************/
 int CopyValue(Value *dest, const Value *src)
 {
     dest->type = ERR_TYPE;
     if (src->type == STR_TYPE) {
-        dest->v.str = strdup(src->v.str);
-        if (!dest->v.str) return E_NO_MEM;
+        StrHeader *h = STR_HEADER(src->v.str);
+        if (h->refs) {
+            h->refs++;
+            StrsShared++;
+        }
+        dest->v.str = src->v.str;
     } else {
         dest->v.val = src->v.val;
     }
@@ -3245,7 +3479,7 @@ int DoCoerce(char type, Value *v)
             if (i == NO_DATE) return E_CANT_COERCE;
             if (*s) return E_CANT_COERCE;
             v->type = DATETIME_TYPE;
-            free(v->v.str);
+            ReleaseStr(v->v.str);
             if (m == NO_TIME) m = 0;
             v->v.val = i * MINUTES_PER_DAY + m;
             return OK;
@@ -3274,7 +3508,7 @@ int DoCoerce(char type, Value *v)
         default: return E_CANT_COERCE;
         }
         v->type = STR_TYPE;
-        v->v.str = strdup(coerce_buf);
+        v->v.str = DupStr(coerce_buf);
         if (!v->v.str) {
             v->type = ERR_TYPE;
             return E_NO_MEM;
@@ -3296,11 +3530,11 @@ int DoCoerce(char type, Value *v)
                 i += (*s++) - '0';
             }
             if (*s) {
-                free (v->v.str);
+                ReleaseStr(v->v.str);
                 v->type = ERR_TYPE;
                 return E_CANT_COERCE;
             }
-            free(v->v.str);
+            ReleaseStr(v->v.str);
             v->type = INT_TYPE;
             v->v.val = i * m;
             return OK;
@@ -3328,7 +3562,7 @@ int DoCoerce(char type, Value *v)
             if (i == NO_DATE) return E_CANT_COERCE;
             if (*s) return E_CANT_COERCE;
             v->type = DATE_TYPE;
-            free(v->v.str);
+            ReleaseStr(v->v.str);
             v->v.val = i;
             return OK;
 
@@ -3355,7 +3589,7 @@ int DoCoerce(char type, Value *v)
             if (ParseLiteralTime(&s, &i)) return E_CANT_COERCE;
             if (*s) return E_CANT_COERCE;
             v->type = TIME_TYPE;
-            free(v->v.str);
+            ReleaseStr(v->v.str);
             v->v.val = i;
             return OK;
 
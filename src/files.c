@@ -17,6 +17,9 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <string.h>
+#ifdef HAVE_STRINGS_H
+#include <strings.h>
+#endif
 #include <errno.h>
 #include <ctype.h>
 #include <sys/stat.h>
@@ -29,6 +32,7 @@
 #endif
 
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -59,15 +63,88 @@ typedef struct cache {
     char const *text;
     int LineNo;
     int LineNoStart;
+    CompiledRem *compiled;
 } CachedLine;
 
+/* A file that the output of an INCLUDECMD DEPENDS command depends
+   on, and what it looked like when the command was run */
+typedef struct {
+    char const *name;
+    struct stat sb;
+    int racy;   /* See StatIsRacy() */
+} CmdDepFile;
+
 typedef struct cheader {
     struct cheader *next;
     char const *filename;
     CachedLine *cache;
     int ownedByMe;
+    int persist;   /* Write to the --cache-file */
+    int mapped;    /* Line text points into the --cache-file mapping */
+    int stat_valid; /* sb describes the file we cached */
+    int stat_racy;  /* ...but might not show a change made since */
+    struct stat sb;
+    int dep_segments; /* Segments run from this file last time */
+    int dep_changed;  /* Changed on disk since we cached it */
+    int ndeps;        /* INCLUDECMD output: the files it depends on */
+    CmdDepFile *deps;
 } CachedFile;
 
+/* An entry in the index of the --cache-file.  Each file in the
+   cache file looks like this:
+
+   F dev ino size mtime mtimens ctime ctimens nlines nbytes namelen\n
+   filename\0\n
+   L lineno linenostart textlen\n
+   text\0\n
+   ... (nlines "L" records occupying nbytes bytes in total)
+
+   The output of an INCLUDECMD DEPENDS command is stored under its
+   "cmd|" name, followed by the files it depends on:
+
+   C ndeps depbytes nlines nbytes namelen\n
+   cmd|\0\n
+   D dev ino size mtime mtimens ctime ctimens namelen\n
+   depname\0\n
+   ... (ndeps "D" records occupying depbytes bytes in total)
+   L ... (as above)
+
+   The text is NUL-terminated so we can point straight into the
+   mapped file.  mtimens and ctimens are the nanosecond parts of the
+   timestamps (0 if stat() doesn't give us them) so that a file
+   rewritten within the same second at the same size still looks
+   changed. */
+#define CACHE_STAT_FIELDS 7
+
+typedef struct {
+    char const *filename;
+    int is_cmd;
+    long long st[CACHE_STAT_FIELDS];
+    int ndeps;
+    char const *deps;
+    size_t depbytes;
+    int nlines;
+    char const *lines;
+    size_t nbytes;
+} DiskCacheEntry;
+
+#define DISK_CACHE_MAGIC "REMIND-LINE-CACHE 3\n"
+
+/* Nanosecond parts of a file's timestamps */
+#if defined(HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC)
+#define STAT_NSEC 1
+#define MTIME_NSEC(sb) ((long) (sb)->st_mtim.tv_nsec)
+#define CTIME_NSEC(sb) ((long) (sb)->st_ctim.tv_nsec)
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC_TV_NSEC)
+#define STAT_NSEC 1
+#define MTIME_NSEC(sb) ((long) (sb)->st_mtimespec.tv_nsec)
+#define CTIME_NSEC(sb) ((long) (sb)->st_ctimespec.tv_nsec)
+#else
+#define STAT_NSEC 0
+#define MTIME_NSEC(sb) 0L
+#define CTIME_NSEC(sb) 0L
+#endif
+
 /* A linked list of filenames if we INCLUDE /some/directory/  */
 typedef struct fname_chain {
     struct fname_chain *next;
@@ -91,8 +168,36 @@ typedef struct {
     long offset;
     CachedLine *CLine;
     int ownedByMe;
+    CachedFile *dep_file;
 } IncludeStruct;
 
+/* Dependency tracking for incremental reloads.  While a daemon runs
+   the reminder script, the run is divided into segments; a segment
+   is the stretch of lines read from one file between INCLUDEs.  For
+   each segment we record the names it reads before writing them and
+   the names it writes, so that when files change we can work out
+   which segments have to be run again.  Names are prefixed with 'v'
+   for variables and 'f' for functions; "o" is the global OMIT
+   context. */
+typedef struct dep_name {
+    struct hash_link link;
+    int flags;
+    char name[VAR_NAME_LEN+2];
+} DepName;
+
+#define DEP_READ  1
+#define DEP_WRITE 2
+
+typedef struct {
+    CachedFile *cf;
+    hash_table names;
+    int have_names;
+    int omit_depth;  /* PUSH-OMIT-CONTEXTs not yet popped */
+    int ran_rem;     /* Has this segment set the trigger state yet? */
+    int opaque;      /* Did something we cannot track */
+    int rerun;       /* Must be re-run in an incremental reload */
+} DepSegment;
+
 typedef struct fn_entry {
     struct hash_link link;
     char const *fname;
@@ -103,8 +208,19 @@ static hash_table FilenameHashTable;
 
 static CachedFile *CachedFiles = (CachedFile *) NULL;
 static CachedLine *CLine = (CachedLine *) NULL;
+
+/* The cached line most recently returned by ReadLine, if any */
+static CachedLine *CurCachedLine = (CachedLine *) NULL;
 static DirectoryFilenameChain *CachedDirectoryChains = NULL;
 
+/* The --cache-file, mapped into memory */
+static char const *DiskCacheMap = NULL;
+static size_t DiskCacheSize = 0;
+static DiskCacheEntry *DiskCacheIndex = NULL;
+static int DiskCacheEntries = 0;
+static int DiskCacheLoaded = 0;
+static int DiskCacheDirty = 0;
+
 /* Current filename */
 static char const *FileName = NULL;
 
@@ -113,13 +229,40 @@ static FILE *fp;
 static IncludeStruct IStack[INCLUDE_NEST];
 static int IStackPtr = 0;
 
+/* Segments of the last run, in the order they were run */
+static int DepTracking = 0;
+static int DepBroken = 0;
+static DepSegment *DepSegments = NULL;
+static int NumDepSegments = 0;
+static int MaxDepSegments = 0;
+static DepSegment *DepCur = NULL;
+
+/* Incremental reload: the segments to re-run and the one being
+   re-run */
+static int *DepPlan = NULL;
+static int DepPlanLen = 0;
+static int DepPlanNext = 0;
+static int DepRerunning = 0;
+static DepSegment DepRerunSeg;
+
 static int ReadLineFromFile (int use_pclose);
 static int CacheFile (char const *fname, int use_pclose);
+static int CacheFileFromDisk (char const *fname, struct stat const *sb);
+static int StatIsRacy (struct stat const *sb);
+static int CacheCmdFromDisk (char const *fname, CmdDepFile const *deps, int ndeps);
+static int StatCmdDeps (char const **depnames, int ndeps, CmdDepFile **deps);
+static void FreeCmdDeps (CmdDepFile *deps, int ndeps);
 static void DestroyCache (CachedFile *cf);
 static int CheckSafety (void);
 static int CheckSafetyAux (struct stat *statbuf);
+static void DepBeginSegment (CachedFile *cf);
+static void DepFinishSegment (void);
+static void DepFreeSegment (DepSegment *seg);
+#ifdef HAVE_GLOB
+static int DirectoryChanged (DirectoryFilenameChain const *dc);
+#endif
 static int PopFile (void);
-static int IncludeCmd(char const *);
+static int IncludeCmd(char const *cmd, char const **depnames, int ndeps);
 
 static unsigned int FnHashFunc(void const *x)
 {
@@ -146,7 +289,7 @@ void InitFiles(void)
 #endif
 }
 
-void SetCurrentFilename(char const *fname)
+static char const *InternFilename(char const *fname)
 {
     FilenameHashEntry *e;
     FilenameHashEntry candidate;
@@ -166,7 +309,12 @@ void SetCurrentFilename(char const *fname)
         }
         hash_table_insert(&FilenameHashTable, e);
     }
-    FileName = e->fname;
+    return e->fname;
+}
+
+void SetCurrentFilename(char const *fname)
+{
+    FileName = InternFilename(fname);
 }
 
 char const *GetCurrentFilename(void)
@@ -266,6 +414,7 @@ int ReadLine(void)
 
 /* If it's cached, read line from the cache */
     if (CLine) {
+        CurCachedLine = CLine;
         CurLine = CLine->text;
         LineNo = CLine->LineNo;
         LineNoStart = CLine->LineNoStart;
@@ -277,9 +426,27 @@ int ReadLine(void)
     }
 
 /* Not cached.  Read from the file. */
+    CurCachedLine = NULL;
     return ReadLineFromFile(0);
 }
 
+/***************************************************************/
+/*                                                             */
+/*  CurrentCompiledRem                                         */
+/*                                                             */
+/*  Return a pointer to the compiled-REM slot of the line most */
+/*  recently read from the cache, or NULL if that line did     */
+/*  not come from the cache.                                   */
+/*                                                             */
+/***************************************************************/
+CompiledRem **CurrentCompiledRem(void)
+{
+    if (!CurCachedLine) {
+        return NULL;
+    }
+    return &(CurCachedLine->compiled);
+}
+
 #define IS_INTERACTIVE() (fileno(fp) == STDIN_FILENO && isatty(STDIN_FILENO) && isatty(STDOUT_FILENO))
 
 /***************************************************************/
@@ -472,6 +639,7 @@ static int OpenFile(char const *fname)
             } else {
                 RunDisabled &= ~RUN_NOTOWNER;
             }
+            DepBeginSegment(h);
             if (FileName) return OK; else return E_NO_MEM;
         }
         h = h->next;
@@ -503,12 +671,47 @@ static int OpenFile(char const *fname)
     if (!fp || !CheckSafety()) return E_CANT_OPEN;
     CLine = NULL;
     if (ShouldCache) {
+        struct stat sb;
+        int have_sb = 0;
+        int persist = 0;
         LineNo = 0;
         LineNoStart = 0;
-        r = CacheFile(fname, 0);
+
+        /* Remember what regular files looked like when we cached
+           them so a reload can tell whether they have changed.
+           Only regular files go in the --cache-file */
+        if (fp != stdin && !fstat(fileno(fp), &sb) && S_ISREG(sb.st_mode)) {
+            have_sb = 1 + StatIsRacy(&sb);
+            if (ScriptCacheFile && !PurgeMode) {
+                persist = 1;
+            }
+        }
+        r = E_CANT_OPEN;
+        if (persist) {
+            r = CacheFileFromDisk(fname, &sb);
+        }
+        if (r == OK) {
+            FCLOSE(fp);
+        } else {
+            r = CacheFile(fname, 0);
+            if (r == OK && have_sb) {
+                CachedFiles->stat_valid = 1;
+                CachedFiles->stat_racy = (have_sb > 1);
+                CachedFiles->sb = sb;
+            }
+            if (r == OK && persist) {
+                CachedFiles->persist = 1;
+                DiskCacheDirty = 1;
+            }
+        }
         if (r == OK) {
             fp = NULL;
             CLine = CachedFiles->cache;
+            DepBeginSegment(CachedFiles);
+            SetCurrentFilename(fname);
+            LineNo = 0;
+            LineNoStart = 0;
+            if (FileName) return OK; else return E_NO_MEM;
         } else {
             if (strcmp(fname, "-")) {
                 fp = fopen(fname, "r");
@@ -521,6 +724,8 @@ static int OpenFile(char const *fname)
             }
         }
     }
+    /* Not cached, so we cannot tell what it depends on */
+    DepBeginSegment(NULL);
     SetCurrentFilename(fname);
     LineNo = 0;
     LineNoStart = 0;
@@ -559,6 +764,14 @@ static int CacheFile(char const *fname, int use_pclose)
         return E_NO_MEM;
     }
     cf->cache = NULL;
+    cf->persist = 0;
+    cf->mapped = 0;
+    cf->stat_valid = 0;
+    cf->stat_racy = 0;
+    cf->dep_segments = 0;
+    cf->dep_changed = 0;
+    cf->ndeps = 0;
+    cf->deps = NULL;
     cf->filename = strdup(fname);
     if (!cf->filename) {
         ShouldCache = 0;
@@ -625,6 +838,7 @@ static int CacheFile(char const *fname, int use_pclose)
                 cl = cl->next;
             }
             cl->next = NULL;
+            cl->compiled = NULL;
             cl->LineNo = LineNo;
             cl->LineNoStart = LineNoStart;
             cl->text = strdup(s);
@@ -649,190 +863,1333 @@ static int CacheFile(char const *fname, int use_pclose)
     return OK;
 }
 
+/* Does a file still look the way it did when we stat'ed it? */
+static int SameStat(struct stat const *a, struct stat const *b)
+{
+    return (a->st_dev == b->st_dev &&
+            a->st_ino == b->st_ino &&
+            a->st_size == b->st_size &&
+            a->st_mtime == b->st_mtime &&
+            MTIME_NSEC(a) == MTIME_NSEC(b) &&
+            a->st_ctime == b->st_ctime &&
+            CTIME_NSEC(a) == CTIME_NSEC(b));
+}
+
 /***************************************************************/
 /*                                                             */
-/*  NextChainedFile - move to the next chained file in a glob  */
-/*  list.                                                      */
+/*  StatIsRacy                                                 */
+/*                                                             */
+/*  Call right after stat'ing a file we are about to read.  If */
+/*  stat() only gives us whole seconds and the file changed in */
+/*  this very second, another change in the same second could  */
+/*  leave it looking just the same, so sb can't be trusted to  */
+/*  tell us whether the file has changed since.                */
 /*                                                             */
 /***************************************************************/
-static int NextChainedFile(IncludeStruct *i)
+static int StatIsRacy(struct stat const *sb)
 {
-    while(i->chain) {
-        FilenameChain *cur = i->chain;
-        i->chain = i->chain->next;
-        if (OpenFile(cur->filename) == OK) {
-            return OK;
-        } else {
-            Eprint("%s: %s", GetErr(E_CANT_OPEN), cur->filename);
-        }
-    }
-    return E_EOF;
+#if STAT_NSEC
+    UNUSED(sb);
+    return 0;
+#else
+    time_t now = time(NULL);
+    return (sb->st_mtime >= now || sb->st_ctime >= now);
+#endif
+}
+
+/* Write the stat info we keep in the --cache-file for sb to buf */
+static void FormatCacheStat(char *buf, size_t len, struct stat const *sb)
+{
+    snprintf(buf, len, "%lu %lu %lu %ld %ld %ld %ld",
+             (unsigned long) sb->st_dev,
+             (unsigned long) sb->st_ino,
+             (unsigned long) sb->st_size,
+             (long) sb->st_mtime, MTIME_NSEC(sb),
+             (long) sb->st_ctime, CTIME_NSEC(sb));
+}
+
+/* Do the CACHE_STAT_FIELDS numbers in st describe sb? */
+static int CacheStatMatches(long long const *st, struct stat const *sb)
+{
+    return ((unsigned long) st[0] == (unsigned long) sb->st_dev &&
+            (unsigned long) st[1] == (unsigned long) sb->st_ino &&
+            (unsigned long) st[2] == (unsigned long) sb->st_size &&
+            (long) st[3] == (long) sb->st_mtime &&
+            (long) st[4] == MTIME_NSEC(sb) &&
+            (long) st[5] == (long) sb->st_ctime &&
+            (long) st[6] == CTIME_NSEC(sb));
 }
 
 /***************************************************************/
 /*                                                             */
-/*  PopFile - we've reached the end.  Pop up to the previous   */
-/*  file, or return E_EOF                                      */
+/*  GetCacheNumber                                             */
+/*                                                             */
+/*  Parse a number terminated by a space or newline from the   */
+/*  --cache-file, never looking at or beyond end.  Returns a   */
+/*  pointer just past the terminator, or NULL on error.        */
 /*                                                             */
 /***************************************************************/
-static int PopFile(void)
+static char const *GetCacheNumber(char const *s, char const *end, long long *val)
 {
-    IncludeStruct *i;
+    int neg = 0;
+    int digits = 0;
+    long long v = 0;
+
+    if (s < end && *s == '-') {
+        neg = 1;
+        s++;
+    }
+    while (s < end && isdigit((unsigned char) *s)) {
+        if (++digits > 18) return NULL;
+        v = v * 10 + (*s - '0');
+        s++;
+    }
+    if (!digits || s >= end || (*s != ' ' && *s != '\n')) return NULL;
+    *val = neg ? -v : v;
+    return s+1;
+}
 
-    pop_excess_ifs(FileName);
-    fp = NULL;
+/***************************************************************/
+/*                                                             */
+/*  UnloadDiskCache                                            */
+/*                                                             */
+/*  Forget the index of the --cache-file and unmap it.  Only   */
+/*  safe once no CachedFile points into the mapping.           */
+/*                                                             */
+/***************************************************************/
+static void UnloadDiskCache(void)
+{
+    if (DiskCacheIndex) free(DiskCacheIndex);
+    DiskCacheIndex = NULL;
+    DiskCacheEntries = 0;
+    if (DiskCacheMap) munmap((void *) DiskCacheMap, DiskCacheSize);
+    DiskCacheMap = NULL;
+    DiskCacheSize = 0;
+}
 
-    if (!IStackPtr) return E_EOF;
-    i = &IStack[IStackPtr-1];
+/***************************************************************/
+/*                                                             */
+/*  LoadDiskCache                                              */
+/*                                                             */
+/*  Map the --cache-file into memory and index the files it    */
+/*  contains.  The lines themselves are only checked when a    */
+/*  file is actually used.  If anything looks wrong, the       */
+/*  cache file is ignored.                                     */
+/*                                                             */
+/***************************************************************/
+static void LoadDiskCache(void)
+{
+    int fd, i;
+    struct stat sb;
+    void *map;
+    char const *s, *end;
+    long long v[10];
+    DiskCacheEntry *e;
+    int max = 0;
+    int is_cmd, nv;
+    size_t magic_len = strlen(DISK_CACHE_MAGIC);
+
+    DiskCacheLoaded = 1;
+    fd = open(ScriptCacheFile, O_RDONLY);
+    if (fd < 0) return;
+
+    /* Only trust a cache file that is ours and that nobody else
+       can write to */
+    if (fstat(fd, &sb) || !S_ISREG(sb.st_mode) ||
+        sb.st_uid != geteuid() ||
+        (sb.st_mode & (S_IWGRP | S_IWOTH)) ||
+        (size_t) sb.st_size < magic_len) {
+        close(fd);
+        return;
+    }
+    map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return;
+    DiskCacheMap = (char const *) map;
+    DiskCacheSize = sb.st_size;
 
-    if (i->chain) {
-        int oldRunDisabled = RunDisabled;
-        if (NextChainedFile(i) == OK) {
-            return OK;
+    s = DiskCacheMap;
+    end = s + DiskCacheSize;
+    if (memcmp(s, DISK_CACHE_MAGIC, magic_len)) goto bad;
+    s += magic_len;
+
+    while (s < end) {
+        if (end - s < 2 || (s[0] != 'F' && s[0] != 'C') || s[1] != ' ') {
+            goto bad;
         }
-        RunDisabled = oldRunDisabled;
+        is_cmd = (s[0] == 'C');
+        s += 2;
+
+        /* A "C" record has ndeps and depbytes where an "F" record
+           has the stat info; either way, v[9] is the filename length,
+           v[8] the size of the lines and v[7] the number of lines */
+        nv = is_cmd ? 5 : 10;
+        for (i=10-nv; i<10; i++) {
+            s = GetCacheNumber(s, end, &v[i]);
+            if (!s) goto bad;
+        }
+        if (v[9] < 1 || v[9] + 2 > end - s || s[v[9]] || s[v[9]+1] != '\n') {
+            goto bad;
+        }
+        if (DiskCacheEntries == max) {
+            max = max ? max * 2 : 64;
+            e = realloc(DiskCacheIndex, max * sizeof(DiskCacheEntry));
+            if (!e) goto bad;
+            DiskCacheIndex = e;
+        }
+        e = &DiskCacheIndex[DiskCacheEntries++];
+        e->filename = s;
+        e->is_cmd = is_cmd;
+        e->ndeps = 0;
+        e->deps = NULL;
+        e->depbytes = 0;
+        for (i=0; i<CACHE_STAT_FIELDS; i++) {
+            e->st[i] = is_cmd ? 0 : v[i];
+        }
+        e->nlines = (int) v[7];
+        s += v[9] + 2;
+        if (is_cmd) {
+            if (v[5] < 1 || v[6] < 0 || v[6] > end - s) goto bad;
+            e->ndeps = (int) v[5];
+            e->deps = s;
+            e->depbytes = (size_t) v[6];
+            s += v[6];
+        }
+        if (v[7] < 0 || v[8] < 0 || v[8] > end - s) goto bad;
+        e->lines = s;
+        e->nbytes = (size_t) v[8];
+        s += v[8];
     }
-
-    if (TopLevel()) {
-        IStackPtr = 0;
-        return E_EOF;
+    if (DebugFlag & DB_TRACE_FILES) {
+        fprintf(ErrFp, tr("Reading cache file `%s'"), ScriptCacheFile);
+        fprintf(ErrFp, "\n");
     }
-    IStackPtr--;
+    return;
 
-    LineNo = i->LineNo;
-    LineNoStart = i->LineNoStart;
-    set_base_if_pointer(i->base_if_pointer);
-    CLine = i->CLine;
-    SetCurrentFilename(i->filename);
-    if (!i->ownedByMe) {
-        RunDisabled |= RUN_NOTOWNER;
-    } else {
-        RunDisabled &= ~RUN_NOTOWNER;
+  bad:
+    if (DebugFlag & DB_TRACE_FILES) {
+        fprintf(ErrFp, tr("Ignoring corrupt cache file `%s'"), ScriptCacheFile);
+        fprintf(ErrFp, "\n");
     }
-    if (!CLine && (i->offset != -1L || !strcmp(i->filename, "-"))) {
-        /* We must open the file, then seek to specified position */
-        if (strcmp(i->filename, "-")) {
-            fp = fopen(i->filename, "r");
-            if (!fp || !CheckSafety()) return E_CANT_OPEN;
-            set_cloexec(fileno(fp));
-            if (PurgeMode) OpenPurgeFile(i->filename, "a");
-        } else {
-            fp = stdin;
-            if (PurgeMode) PurgeFP = stdout;
+    UnloadDiskCache();
+}
+
+/* Find fname in the index of the --cache-file */
+static DiskCacheEntry const *FindDiskCacheEntry(char const *fname, int is_cmd)
+{
+    int i;
+
+    if (!DiskCacheLoaded) LoadDiskCache();
+
+    for (i=0; i<DiskCacheEntries; i++) {
+        if (DiskCacheIndex[i].is_cmd == is_cmd &&
+            !strcmp(DiskCacheIndex[i].filename, fname)) {
+            return &DiskCacheIndex[i];
         }
-        if (fp != stdin)
-            (void) fseek(fp, i->offset, 0);  /* Trust that it works... */
     }
-    return OK;
+    return NULL;
 }
 
 /***************************************************************/
 /*                                                             */
-/*  DoInclude                                                  */
+/*  CachedFileFromDisk                                         */
 /*                                                             */
-/*  The INCLUDE command.                                       */
+/*  Build a cached file from the lines of entry e of the       */
+/*  --cache-file and put it at the head of CachedFiles.  The   */
+/*  line text is used in place in the mapped file.             */
 /*                                                             */
 /***************************************************************/
-int DoInclude(ParsePtr p, enum TokTypes tok)
+static int CachedFileFromDisk(char const *fname, DiskCacheEntry const *e,
+                              int ownedByMe)
 {
-    DynamicBuffer buf;
-    DynamicBuffer fullname;
-    DynamicBuffer path;
-    int r, e;
+    CachedFile *cf;
+    CachedLine *cl = NULL;
+    char const *s, *end;
+    long long v[3];
+    int i, j;
 
-    r = OK;
-    char const *s;
-    DBufInit(&buf);
-    DBufInit(&fullname);
-    DBufInit(&path);
-    if ( (r=ParseTokenOrQuotedString(p, &buf)) ) return r;
-    e = VerifyEoln(p);
-    if (e) Eprint("%s", GetErr(e));
+    cf = NEW(CachedFile);
+    if (!cf) return E_NO_MEM;
+    cf->cache = NULL;
+    cf->persist = 1;
+    cf->mapped = 1;
+    cf->stat_valid = 0;
+    cf->stat_racy = 0;
+    cf->dep_segments = 0;
+    cf->dep_changed = 0;
+    cf->ndeps = 0;
+    cf->deps = NULL;
+    cf->ownedByMe = ownedByMe;
+    cf->filename = strdup(fname);
+    if (!cf->filename) {
+        free(cf);
+        return E_NO_MEM;
+    }
 
-    if ((tok == T_IncludeR || tok == T_IncludeSys) &&
-        *(DBufValue(&buf)) != '/') {
-        /* Relative include: Include relative to dir
-           containing current file */
-        if (tok == T_IncludeR) {
-            if (DBufPuts(&path, FileName) != OK) {
-                r = E_NO_MEM;
-                goto bailout;
-            }
-        } else {
-            if (DBufPuts(&path, SysDir) != OK ||
-                DBufPutc(&path, '/') != OK) {
-                r = E_NO_MEM;
-                goto bailout;
-            }
+    s = e->lines;
+    end = s + e->nbytes;
+    for (i=0; i<e->nlines; i++) {
+        if (end - s < 2 || s[0] != 'L' || s[1] != ' ') goto bad;
+        s += 2;
+        for (j=0; j<3; j++) {
+            s = GetCacheNumber(s, end, &v[j]);
+            if (!s) goto bad;
         }
-        if (DBufLen(&path) == 0) {
-            s = DBufValue(&buf);
+        if (v[2] < 0 || v[2] + 2 > end - s || s[v[2]] || s[v[2]+1] != '\n') {
+            goto bad;
+        }
+        if (!cl) {
+            cl = cf->cache = NEW(CachedLine);
         } else {
-            char *t = DBufValue(&path) + DBufLen(&path) - 1;
-            while (t > DBufValue(&path) && *t != '/') t--;
-            if (*t == '/') {
-                *t = 0;
-                if (DBufPuts(&fullname, DBufValue(&path)) != OK) {
-                    r = E_NO_MEM;
-                    goto bailout;
-                }
-                if (DBufPuts(&fullname, "/") != OK) {
-                    r = E_NO_MEM;
-                    goto bailout;
-                }
-                if (DBufPuts(&fullname, DBufValue(&buf)) != OK) {
-                    r = E_NO_MEM;
-                    goto bailout;
-                }
-                s = DBufValue(&fullname);
-            } else {
-                s = DBufValue(&buf);
-            }
+            cl->next = NEW(CachedLine);
+            cl = cl->next;
         }
-    } else {
-        s = DBufValue(&buf);
+        if (!cl) {
+            DestroyCache(cf);
+            return E_NO_MEM;
+        }
+        cl->next = NULL;
+        cl->compiled = NULL;
+        cl->LineNo = (int) v[0];
+        cl->LineNoStart = (int) v[1];
+        cl->text = s;
+        s += v[2] + 2;
     }
-    if ( (r=IncludeFile(s)) ) {
-        goto bailout;
+    if (s != end) goto bad;
+
+    if (DebugFlag & DB_TRACE_FILES) {
+        fprintf(ErrFp, tr("Reading `%s': Found in cache"), fname);
+        fprintf(ErrFp, "\n");
     }
 
-  bailout:
-    DBufFree(&buf);
-    DBufFree(&path);
-    DBufFree(&fullname);
-    return r;
+    /* Put the cached file at the head of the queue */
+    cf->next = CachedFiles;
+    CachedFiles = cf;
+    return OK;
+
+  bad:
+    DestroyCache(cf);
+    return E_CANT_OPEN;
 }
 
 /***************************************************************/
 /*                                                             */
-/*  DoIncludeCmd                                               */
+/*  CacheFileFromDisk                                          */
 /*                                                             */
-/*  The INCLUDECMD command.                                    */
+/*  Set up a cached file from the --cache-file if it has an    */
+/*  up-to-date copy of fname, whose stat info is in sb.        */
+/*  Returns OK on success; on failure, the caller should fall  */
+/*  back to CacheFile().                                       */
 /*                                                             */
 /***************************************************************/
-int DoIncludeCmd(ParsePtr p)
+static int CacheFileFromDisk(char const *fname, struct stat const *sb)
 {
-    DynamicBuffer buf;
+    DiskCacheEntry const *e = FindDiskCacheEntry(fname, 0);
     int r;
-    int ch;
-    char append_buf[2];
-    int seen_nonspace = 0;
 
-    append_buf[1] = 0;
+    if (!e) return E_CANT_OPEN;
 
-    DBufInit(&buf);
+    /* Has the file changed since it was cached? */
+    if (!CacheStatMatches(e->st, sb)) {
+        return E_CANT_OPEN;
+    }
 
-    while(1) {
-        ch = ParseChar(p, &r, 0);
-        if (r) {
-            DBufFree(&buf);
-            return r;
-        }
-        if (!ch) {
-            break;
-        }
-        if (isspace(ch) && !seen_nonspace) {
-            continue;
+    r = CachedFileFromDisk(fname, e, (RunDisabled & RUN_NOTOWNER) ? 0 : 1);
+    if (r == OK) {
+        CachedFiles->stat_valid = 1;
+        CachedFiles->sb = *sb;
+    }
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CacheCmdFromDisk                                           */
+/*                                                             */
+/*  Set up the cached output of an INCLUDECMD DEPENDS command  */
+/*  from the --cache-file, if it was stored with the same      */
+/*  dependencies and none of them has changed since.  The      */
+/*  caller owns deps.                                          */
+/*                                                             */
+/***************************************************************/
+static int CacheCmdFromDisk(char const *fname, CmdDepFile const *deps, int ndeps)
+{
+    DiskCacheEntry const *e = FindDiskCacheEntry(fname, 1);
+    char const *s, *end;
+    long long v[CACHE_STAT_FIELDS+1];
+    int i, j, r;
+
+    if (!e || e->ndeps != ndeps) return E_CANT_OPEN;
+
+    s = e->deps;
+    end = s + e->depbytes;
+    for (i=0; i<ndeps; i++) {
+        if (end - s < 2 || s[0] != 'D' || s[1] != ' ') return E_CANT_OPEN;
+        s += 2;
+        for (j=0; j<=CACHE_STAT_FIELDS; j++) {
+            s = GetCacheNumber(s, end, &v[j]);
+            if (!s) return E_CANT_OPEN;
+        }
+        j = CACHE_STAT_FIELDS;
+        if (v[j] < 1 || v[j] + 2 > end - s || s[v[j]] || s[v[j]+1] != '\n') {
+            return E_CANT_OPEN;
+        }
+        if (strcmp(s, deps[i].name) || !CacheStatMatches(v, &deps[i].sb)) {
+            return E_CANT_OPEN;
+        }
+        s += v[j] + 2;
+    }
+    if (s != end) return E_CANT_OPEN;
+
+    r = CachedFileFromDisk(fname, e, (fname[0] == '!') ? 0 : 1);
+    if (r != OK) return r;
+
+    /* Keep our own copy of the dependencies */
+    CachedFiles->deps = malloc(ndeps * sizeof(CmdDepFile));
+    if (!CachedFiles->deps) {
+        DestroyCache(CachedFiles);
+        return E_NO_MEM;
+    }
+    for (i=0; i<ndeps; i++) {
+        CachedFiles->deps[i].sb = deps[i].sb;
+        CachedFiles->deps[i].racy = deps[i].racy;
+        CachedFiles->deps[i].name = strdup(deps[i].name);
+        if (!CachedFiles->deps[i].name) {
+            CachedFiles->ndeps = i;
+            DestroyCache(CachedFiles);
+            return E_NO_MEM;
+        }
+    }
+    CachedFiles->ndeps = ndeps;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  StatCmdDeps                                                */
+/*                                                             */
+/*  Make a newly-allocated *deps describing the ndeps files    */
+/*  named in depnames as they are now.  Returns OK, or         */
+/*  E_CANT_OPEN if a file could not be stat'ed, or -1 if we    */
+/*  ran out of memory (in which case *deps is not set.)        */
+/*                                                             */
+/***************************************************************/
+static int StatCmdDeps(char const **depnames, int ndeps, CmdDepFile **deps)
+{
+    CmdDepFile *d;
+    int i, r = OK;
+
+    d = calloc(ndeps, sizeof(CmdDepFile));
+    if (!d) return -1;
+    for (i=0; i<ndeps; i++) {
+        d[i].name = strdup(depnames[i]);
+        if (!d[i].name) {
+            FreeCmdDeps(d, i);
+            return -1;
+        }
+        if (stat(d[i].name, &d[i].sb)) {
+            r = E_CANT_OPEN;
+        } else {
+            d[i].racy = StatIsRacy(&d[i].sb);
+        }
+    }
+    *deps = d;
+    return r;
+}
+
+static void FreeCmdDeps(CmdDepFile *deps, int ndeps)
+{
+    int i;
+
+    if (!deps) return;
+    for (i=0; i<ndeps; i++) {
+        free((char *) deps[i].name);
+    }
+    free(deps);
+}
+
+/* Write the "D" record for an INCLUDECMD dependency to out, or
+   just measure it if out is NULL.  Returns its length in bytes. */
+static size_t WriteCmdDep(FILE *out, CmdDepFile const *d)
+{
+    char st[160];
+    char hdr[200];
+    size_t len;
+
+    FormatCacheStat(st, sizeof(st), &d->sb);
+    snprintf(hdr, sizeof(hdr), "D %s %lu\n", st,
+             (unsigned long) strlen(d->name));
+    len = strlen(hdr) + strlen(d->name) + 2;
+    if (out) {
+        fputs(hdr, out);
+        fputs(d->name, out);
+        fputc(0, out);
+        fputc('\n', out);
+    }
+    return len;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SaveDiskCache                                              */
+/*                                                             */
+/*  If --cache-file was given and we read any file that was    */
+/*  not already in it, rewrite it with every cached regular    */
+/*  file.  The new cache file is written under a temporary     */
+/*  name and renamed into place, so concurrent invocations     */
+/*  always see a complete cache file.                          */
+/*                                                             */
+/***************************************************************/
+void SaveDiskCache(void)
+{
+    DynamicBuffer tmpname;
+    char num[64];
+    char st[160];
+    CachedFile *cf;
+    CachedLine *cl;
+    FILE *out;
+    int fd, nlines, i;
+    size_t nbytes, depbytes;
+
+    if (!ScriptCacheFile || !DiskCacheDirty) return;
+    DiskCacheDirty = 0;
+
+    DBufInit(&tmpname);
+    snprintf(num, sizeof(num), ".%d", (int) getpid());
+    if (DBufPuts(&tmpname, ScriptCacheFile) != OK ||
+        DBufPuts(&tmpname, num) != OK) {
+        DBufFree(&tmpname);
+        return;
+    }
+    fd = open(DBufValue(&tmpname), O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 || !(out = fdopen(fd, "w"))) {
+        if (fd >= 0) close(fd);
+        fprintf(ErrFp, "%s: %s\n", DBufValue(&tmpname), strerror(errno));
+        DBufFree(&tmpname);
+        return;
+    }
+
+    fputs(DISK_CACHE_MAGIC, out);
+    for (cf = CachedFiles; cf; cf = cf->next) {
+        /* Leave out anything a later run couldn't tell was stale */
+        if (!cf->persist || cf->stat_racy) continue;
+        nlines = 0;
+        nbytes = 0;
+        for (cl = cf->cache; cl; cl = cl->next) {
+            nlines++;
+            nbytes += snprintf(num, sizeof(num), "L %d %d %lu\n",
+                               cl->LineNo, cl->LineNoStart,
+                               (unsigned long) strlen(cl->text));
+            nbytes += strlen(cl->text) + 2;
+        }
+        if (cf->ndeps) {
+            depbytes = 0;
+            for (i=0; i<cf->ndeps; i++) {
+                depbytes += WriteCmdDep(NULL, &cf->deps[i]);
+            }
+            fprintf(out, "C %d %lu %d %lu %lu\n",
+                    cf->ndeps, (unsigned long) depbytes,
+                    nlines, (unsigned long) nbytes,
+                    (unsigned long) strlen(cf->filename));
+        } else {
+            FormatCacheStat(st, sizeof(st), &cf->sb);
+            fprintf(out, "F %s %d %lu %lu\n", st,
+                    nlines, (unsigned long) nbytes,
+                    (unsigned long) strlen(cf->filename));
+        }
+        fputs(cf->filename, out);
+        fputc(0, out);
+        fputc('\n', out);
+        for (i=0; i<cf->ndeps; i++) {
+            WriteCmdDep(out, &cf->deps[i]);
+        }
+        for (cl = cf->cache; cl; cl = cl->next) {
+            fprintf(out, "L %d %d %lu\n", cl->LineNo, cl->LineNoStart,
+                    (unsigned long) strlen(cl->text));
+            fputs(cl->text, out);
+            fputc(0, out);
+            fputc('\n', out);
+        }
+    }
+    fd = ferror(out);
+    if (fclose(out) || fd ||
+        rename(DBufValue(&tmpname), ScriptCacheFile) < 0) {
+        fprintf(ErrFp, "%s: %s\n", ScriptCacheFile, strerror(errno));
+        unlink(DBufValue(&tmpname));
+    } else if (DebugFlag & DB_TRACE_FILES) {
+        fprintf(ErrFp, tr("Writing cache file `%s'"), ScriptCacheFile);
+        fprintf(ErrFp, "\n");
+    }
+    DBufFree(&tmpname);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CachedFileChanged                                          */
+/*                                                             */
+/*  Has a cached file changed on disk since we cached it?      */
+/*  INCLUDECMD DEPENDS output has changed if any of the files  */
+/*  it depends on has.  Anything else we cannot check (such    */
+/*  as other INCLUDECMD output) counts as changed; stdin never */
+/*  changes.                                                   */
+/*                                                             */
+/***************************************************************/
+static int CachedFileChanged(CachedFile const *cf)
+{
+    struct stat sb;
+    int i;
+
+    if (!strcmp(cf->filename, "-")) return 0;
+    if (cf->ndeps) {
+        /* INCLUDECMD output is good until what it depends on changes */
+        for (i=0; i<cf->ndeps; i++) {
+            if (cf->deps[i].racy || stat(cf->deps[i].name, &sb) ||
+                !SameStat(&sb, &cf->deps[i].sb)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    if (!cf->stat_valid || cf->stat_racy || stat(cf->filename, &sb)) return 1;
+    return !SameStat(&sb, &cf->sb);
+}
+
+static void DiscardCachedFile(CachedFile *cf)
+{
+    if (DebugFlag & DB_TRACE_FILES) {
+        fprintf(ErrFp, tr("Discarding cached copy of `%s'"), cf->filename);
+        fprintf(ErrFp, "\n");
+    }
+    if (cf->persist) DiskCacheDirty = 1;
+    DestroyCache(cf);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FlushChangedFiles                                          */
+/*                                                             */
+/*  Before re-reading the reminder script, discard cached      */
+/*  files that have changed on disk, along with anything we    */
+/*  cannot check (such as INCLUDECMD output without DEPENDS)   */
+/*  and the cached directory listings.  Unchanged files stay   */
+/*  cached.                                                    */
+/*                                                             */
+/***************************************************************/
+void FlushChangedFiles(void)
+{
+    CachedFile *cf, *next;
+    DirectoryFilenameChain *dc;
+
+    for (cf = CachedFiles; cf; cf = next) {
+        next = cf->next;
+        if (CachedFileChanged(cf)) {
+            DiscardCachedFile(cf);
+        }
+    }
+
+    while (CachedDirectoryChains) {
+        dc = CachedDirectoryChains;
+        CachedDirectoryChains = dc->next;
+        FreeChain(dc->chain);
+        free((char *) dc->dirname);
+        free(dc);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Dependency tracking                                        */
+/*                                                             */
+/*  The Dep* functions are called by the interpreter to note   */
+/*  what the segment being run reads and writes.  They do      */
+/*  nothing unless TrackDependencies() has been called.        */
+/*                                                             */
+/***************************************************************/
+void TrackDependencies(void)
+{
+    DepTracking = 1;
+}
+
+static unsigned int DepHashFunc(void const *x)
+{
+    DepName const *n = (DepName const *) x;
+    return HashVal_preservecase(n->name);
+}
+
+static int DepCompareFunc(void const *a, void const *b)
+{
+    DepName const *n1 = (DepName const *) a;
+    DepName const *n2 = (DepName const *) b;
+    return strcmp(n1->name, n2->name);
+}
+
+static void DepInitSegment(DepSegment *seg, CachedFile *cf)
+{
+    seg->cf = cf;
+    seg->have_names = 0;
+    seg->omit_depth = 0;
+    seg->ran_rem = 0;
+    seg->opaque = 0;
+    seg->rerun = 0;
+}
+
+static void DepFreeSegment(DepSegment *seg)
+{
+    DepName *n, *next;
+
+    if (!seg->have_names) return;
+    n = hash_table_next(&seg->names, NULL);
+    while (n) {
+        next = hash_table_next(&seg->names, n);
+        hash_table_delete_no_resize(&seg->names, n);
+        free(n);
+        n = next;
+    }
+    hash_table_free(&seg->names);
+    seg->have_names = 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ResetDependencies                                          */
+/*                                                             */
+/*  Forget the segments of the last run.  Called before the    */
+/*  whole script is run.                                       */
+/*                                                             */
+/***************************************************************/
+void ResetDependencies(void)
+{
+    CachedFile *cf;
+    int i;
+
+    for (i=0; i<NumDepSegments; i++) {
+        DepFreeSegment(&DepSegments[i]);
+    }
+    DepFreeSegment(&DepRerunSeg);
+    DepRerunSeg.cf = NULL;
+    NumDepSegments = 0;
+    DepBroken = 0;
+    DepCur = NULL;
+    DepRerunning = 0;
+    DepPlanLen = 0;
+    DepPlanNext = 0;
+    for (cf = CachedFiles; cf; cf = cf->next) {
+        cf->dep_segments = 0;
+    }
+}
+
+static void DepFinishSegment(void)
+{
+    if (!DepCur) return;
+
+    /* An unbalanced PUSH-OMIT-CONTEXT leaks into whatever comes next */
+    if (DepCur->omit_depth) DepCur->opaque = 1;
+    DepCur = NULL;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DepBeginSegment                                            */
+/*                                                             */
+/*  Start recording a segment from the cached file cf.  A NULL */
+/*  cf means we are reading a file we could not cache.         */
+/*                                                             */
+/***************************************************************/
+static void DepBeginSegment(CachedFile *cf)
+{
+    DepSegment *seg;
+
+    if (!DepTracking) return;
+    DepFinishSegment();
+    if (!cf) {
+        DepBroken = 1;
+        return;
+    }
+
+    /* An OMITFUNC result memoized in an earlier segment must not
+       hide this segment's reads from us */
+    VarGeneration++;
+
+    if (DepRerunning) {
+        /* A re-run file that now INCLUDEs another can't be re-run
+           on its own */
+        if (DepRerunSeg.cf) {
+            DepRerunSeg.opaque = 1;
+        } else {
+            DepRerunSeg.cf = cf;
+        }
+        DepCur = &DepRerunSeg;
+        return;
+    }
+
+    if (NumDepSegments >= MaxDepSegments) {
+        int n = MaxDepSegments ? MaxDepSegments * 2 : 64;
+        seg = realloc(DepSegments, n * sizeof(DepSegment));
+        if (!seg) {
+            DepBroken = 1;
+            return;
+        }
+        DepSegments = seg;
+        MaxDepSegments = n;
+    }
+    seg = &DepSegments[NumDepSegments++];
+    DepInitSegment(seg, cf);
+    cf->dep_segments++;
+    DepCur = seg;
+}
+
+static void DepMakeKey(char *key, int kind, char const *name)
+{
+    int i;
+
+    key[0] = (char) kind;
+    for (i=1; name && *name && i<=VAR_NAME_LEN; i++, name++) {
+        key[i] = (char) tolower((unsigned char) *name);
+    }
+    key[i] = 0;
+}
+
+static void DepNote(int kind, char const *name, int flag)
+{
+    DepName candidate, *n;
+
+    if (!DepCur) return;
+
+    /* OMITs inside PUSH-OMIT-CONTEXT...POP-OMIT-CONTEXT don't escape */
+    if (kind == 'o' && flag == DEP_WRITE && DepCur->omit_depth) return;
+
+    DepMakeKey(candidate.name, kind, name);
+    if (!DepCur->have_names) {
+        if (hash_table_init(&DepCur->names, offsetof(DepName, link),
+                            DepHashFunc, DepCompareFunc) < 0) {
+            DepCur->opaque = 1;
+            return;
+        }
+        DepCur->have_names = 1;
+    }
+    n = hash_table_find(&DepCur->names, &candidate);
+    if (!n) {
+        n = NEW(DepName);
+        if (!n) {
+            DepCur->opaque = 1;
+            return;
+        }
+        strcpy(n->name, candidate.name);
+        n->flags = 0;
+        hash_table_insert(&DepCur->names, n);
+    }
+    if (flag == DEP_WRITE) {
+        n->flags |= DEP_WRITE;
+    } else if (!(n->flags & DEP_WRITE)) {
+        /* Only reads of things we haven't set ourselves count */
+        n->flags |= DEP_READ;
+    }
+}
+
+/* kind is 'v' for a variable, 'f' for a function or 'o' (with a
+   NULL name) for the global OMIT context */
+void DepRead(int kind, char const *name)
+{
+    DepNote(kind, name, DEP_READ);
+}
+
+void DepWrite(int kind, char const *name)
+{
+    DepNote(kind, name, DEP_WRITE);
+}
+
+void DepPushOmits(void)
+{
+    if (!DepCur) return;
+    DepRead('o', NULL);
+    DepCur->omit_depth++;
+}
+
+void DepPopOmits(void)
+{
+    if (!DepCur) return;
+    if (DepCur->omit_depth) {
+        DepCur->omit_depth--;
+    } else {
+        /* Popping a context pushed by some other file */
+        DepWrite('o', NULL);
+        DepCur->opaque = 1;
+    }
+}
+
+/* A REM sets the trigger state; reading trigger state that an
+   earlier segment left behind is not something we track */
+void DepNoteTrigger(int set)
+{
+    if (!DepCur) return;
+    if (set) {
+        DepCur->ran_rem = 1;
+    } else if (!DepCur->ran_rem) {
+        DepCur->opaque = 1;
+    }
+}
+
+/* Builtins such as trigdate() return the trigger state */
+void DepNoteBuiltin(char const *name)
+{
+    if (!DepCur) return;
+    if (!strncmp(name, "trig", 4) && strcmp(name, "trigger")) {
+        DepNoteTrigger(0);
+    }
+}
+
+/* Something we can't track, such as a TRANSLATE or SET $SysVar */
+void DepOpaque(void)
+{
+    if (DepCur) DepCur->opaque = 1;
+}
+
+/* Does a have a name with one of aflags that b has with one of bflags? */
+static int DepIntersect(DepSegment const *a, int aflags,
+                        DepSegment const *b, int bflags)
+{
+    DepName *n, *m;
+
+    if (!a->have_names || !b->have_names) return 0;
+    for (n = hash_table_next((hash_table *) &a->names, NULL); n;
+         n = hash_table_next((hash_table *) &a->names, n)) {
+        if (!(n->flags & aflags)) continue;
+        m = hash_table_find((hash_table *) &b->names, n);
+        if (m && (m->flags & bflags)) return 1;
+    }
+    return 0;
+}
+
+/* Does b write everything that a writes? */
+static int DepWritesSubset(DepSegment const *a, DepSegment const *b)
+{
+    DepName *n, *m;
+
+    if (!a->have_names) return 1;
+    for (n = hash_table_next((hash_table *) &a->names, NULL); n;
+         n = hash_table_next((hash_table *) &a->names, n)) {
+        if (!(n->flags & DEP_WRITE)) continue;
+        if (!b->have_names) return 0;
+        m = hash_table_find((hash_table *) &b->names, n);
+        if (!m || !(m->flags & DEP_WRITE)) return 0;
+    }
+    return 1;
+}
+
+/* OMITs only ever add to the global OMIT context, so a segment that
+   adds any can't be re-run on top of what the last run left behind:
+   anything it no longer OMITs would stay OMITted */
+static int DepWritesOmits(DepSegment const *seg)
+{
+    DepName candidate, *n;
+
+    if (!seg->have_names) return 0;
+    DepMakeKey(candidate.name, 'o', NULL);
+    n = hash_table_find((hash_table *) &seg->names, &candidate);
+    return (n && (n->flags & DEP_WRITE));
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PlanIncrementalReload                                      */
+/*                                                             */
+/*  Work out which segments of the last run must be re-run     */
+/*  because their files changed or because they read           */
+/*  something a re-run segment writes.  Re-running them        */
+/*  against the state the last run left behind is only right   */
+/*  if nothing from the first re-run segment on overwrote what */
+/*  they read, so check that too.                              */
+/*                                                             */
+/*  Returns the number of segments to re-run, or -1 if the     */
+/*  whole script must be run again.                            */
+/*                                                             */
+/***************************************************************/
+int PlanIncrementalReload(void)
+{
+    CachedFile *cf;
+    DepSegment *a, *b;
+    int i, j, n = 0;
+#ifdef HAVE_GLOB
+    DirectoryFilenameChain *dc;
+#endif
+
+    DepPlanLen = 0;
+    DepPlanNext = 0;
+    /* Re-run reminders would be deduplicated against the ones they
+       replace */
+    if (!DepTracking || DepBroken || DepRerunning || !NumDepSegments ||
+        DedupeReminders) {
+        return -1;
+    }
+
+#ifdef HAVE_GLOB
+    for (dc = CachedDirectoryChains; dc; dc = dc->next) {
+        if (DirectoryChanged(dc)) return -1;
+    }
+#endif
+
+    for (cf = CachedFiles; cf; cf = cf->next) {
+        cf->dep_changed = CachedFileChanged(cf);
+        if (cf->dep_changed && cf->dep_segments > 1) return -1;
+    }
+
+    for (i=0; i<NumDepSegments; i++) {
+        a = &DepSegments[i];
+        if (!a->cf) return -1;
+        a->rerun = a->cf->dep_changed;
+        for (j=0; j<i && !a->rerun; j++) {
+            b = &DepSegments[j];
+            if (b->rerun && DepIntersect(b, DEP_WRITE, a, DEP_READ)) {
+                a->rerun = 1;
+            }
+        }
+        if (a->rerun) n++;
+    }
+    if (!n) return 0;
+
+    for (i=0; i<NumDepSegments; i++) {
+        a = &DepSegments[i];
+        if (!a->rerun) continue;
+        if (a->opaque || a->cf->dep_segments != 1 || DepWritesOmits(a)) {
+            return -1;
+        }
+        for (j=i; j<NumDepSegments; j++) {
+            b = &DepSegments[j];
+            if (DepIntersect(a, DEP_READ, b, DEP_WRITE)) return -1;
+            if (j == i) continue;
+            if (b->opaque) return -1;
+            if (!b->rerun && DepIntersect(a, DEP_WRITE, b, DEP_WRITE)) {
+                return -1;
+            }
+        }
+    }
+
+    free(DepPlan);
+    DepPlan = malloc(n * sizeof(int));
+    if (!DepPlan) return -1;
+    for (i=0; i<NumDepSegments; i++) {
+        if (DepSegments[i].rerun) DepPlan[DepPlanLen++] = i;
+    }
+    return n;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  BeginRerun                                                 */
+/*                                                             */
+/*  Get ready to re-run the next planned segment, and return   */
+/*  the name of its file, or NULL if there are no more.        */
+/*                                                             */
+/***************************************************************/
+char const *BeginRerun(void)
+{
+    DepSegment *seg;
+    char const *fname;
+
+    if (DepPlanNext >= DepPlanLen) return NULL;
+    seg = &DepSegments[DepPlan[DepPlanNext]];
+    fname = InternFilename(seg->cf->filename);
+    if (seg->cf->dep_changed) {
+        DiscardCachedFile(seg->cf);
+    }
+    DepInitSegment(&DepRerunSeg, NULL);
+    DepRerunning = 1;
+    return fname;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  EndRerun                                                   */
+/*                                                             */
+/*  Replace the planned segment with the one we just re-ran.   */
+/*  Returns 0 if the new version of the file reads or writes   */
+/*  things that mean the whole script must be run again.       */
+/*                                                             */
+/***************************************************************/
+int EndRerun(void)
+{
+    int i = DepPlan[DepPlanNext];
+    int j;
+    DepSegment *old = &DepSegments[i];
+    DepSegment *seg = &DepRerunSeg;
+    DepSegment *b;
+    int ok;
+
+    DepFinishSegment();
+    DepRerunning = 0;
+
+    ok = (seg->cf && !seg->opaque && !DepBroken && !DepWritesOmits(seg) &&
+          DepWritesSubset(old, seg));
+    for (j=i; ok && j<NumDepSegments; j++) {
+        b = &DepSegments[j];
+        if (DepIntersect(seg, DEP_READ, b, DEP_WRITE)) ok = 0;
+        if (j > i && !b->rerun &&
+            (DepIntersect(seg, DEP_WRITE, b, DEP_READ | DEP_WRITE))) {
+            ok = 0;
+        }
+    }
+    if (!ok) {
+        DepFreeSegment(seg);
+        seg->cf = NULL;
+        return 0;
+    }
+
+    DepFreeSegment(old);
+    *old = *seg;
+    old->rerun = 1;
+    old->cf->dep_segments = 1;
+    seg->have_names = 0;
+    seg->cf = NULL;
+    DepPlanNext++;
+    return 1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  NextChainedFile - move to the next chained file in a glob  */
+/*  list.                                                      */
+/*                                                             */
+/***************************************************************/
+static int NextChainedFile(IncludeStruct *i)
+{
+    while(i->chain) {
+        FilenameChain *cur = i->chain;
+        i->chain = i->chain->next;
+        if (OpenFile(cur->filename) == OK) {
+            return OK;
+        } else {
+            Eprint("%s: %s", GetErr(E_CANT_OPEN), cur->filename);
+            DepBroken = 1;
+        }
+    }
+    return E_EOF;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PopFile - we've reached the end.  Pop up to the previous   */
+/*  file, or return E_EOF                                      */
+/*                                                             */
+/***************************************************************/
+static int PopFile(void)
+{
+    IncludeStruct *i;
+
+    pop_excess_ifs(FileName);
+    fp = NULL;
+
+    if (!IStackPtr) return E_EOF;
+    i = &IStack[IStackPtr-1];
+
+    if (i->chain) {
+        int oldRunDisabled = RunDisabled;
+        if (NextChainedFile(i) == OK) {
+            return OK;
+        }
+        RunDisabled = oldRunDisabled;
+    }
+
+    if (TopLevel()) {
+        IStackPtr = 0;
+        DepFinishSegment();
+        return E_EOF;
+    }
+    IStackPtr--;
+
+    LineNo = i->LineNo;
+    LineNoStart = i->LineNoStart;
+    set_base_if_pointer(i->base_if_pointer);
+    CLine = i->CLine;
+    SetCurrentFilename(i->filename);
+    if (!i->ownedByMe) {
+        RunDisabled |= RUN_NOTOWNER;
+    } else {
+        RunDisabled &= ~RUN_NOTOWNER;
+    }
+    DepBeginSegment(i->dep_file);
+    if (!CLine && (i->offset != -1L || !strcmp(i->filename, "-"))) {
+        /* We must open the file, then seek to specified position */
+        if (strcmp(i->filename, "-")) {
+            fp = fopen(i->filename, "r");
+            if (!fp || !CheckSafety()) return E_CANT_OPEN;
+            set_cloexec(fileno(fp));
+            if (PurgeMode) OpenPurgeFile(i->filename, "a");
+        } else {
+            fp = stdin;
+            if (PurgeMode) PurgeFP = stdout;
+        }
+        if (fp != stdin)
+            (void) fseek(fp, i->offset, 0);  /* Trust that it works... */
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoInclude                                                  */
+/*                                                             */
+/*  The INCLUDE command.                                       */
+/*                                                             */
+/***************************************************************/
+int DoInclude(ParsePtr p, enum TokTypes tok)
+{
+    DynamicBuffer buf;
+    DynamicBuffer fullname;
+    DynamicBuffer path;
+    int r, e;
+
+    r = OK;
+    char const *s;
+    DBufInit(&buf);
+    DBufInit(&fullname);
+    DBufInit(&path);
+    if ( (r=ParseTokenOrQuotedString(p, &buf)) ) return r;
+    e = VerifyEoln(p);
+    if (e) Eprint("%s", GetErr(e));
+
+    if ((tok == T_IncludeR || tok == T_IncludeSys) &&
+        *(DBufValue(&buf)) != '/') {
+        /* Relative include: Include relative to dir
+           containing current file */
+        if (tok == T_IncludeR) {
+            if (DBufPuts(&path, FileName) != OK) {
+                r = E_NO_MEM;
+                goto bailout;
+            }
+        } else {
+            if (DBufPuts(&path, SysDir) != OK ||
+                DBufPutc(&path, '/') != OK) {
+                r = E_NO_MEM;
+                goto bailout;
+            }
+        }
+        if (DBufLen(&path) == 0) {
+            s = DBufValue(&buf);
+        } else {
+            char *t = DBufValue(&path) + DBufLen(&path) - 1;
+            while (t > DBufValue(&path) && *t != '/') t--;
+            if (*t == '/') {
+                *t = 0;
+                if (DBufPuts(&fullname, DBufValue(&path)) != OK) {
+                    r = E_NO_MEM;
+                    goto bailout;
+                }
+                if (DBufPuts(&fullname, "/") != OK) {
+                    r = E_NO_MEM;
+                    goto bailout;
+                }
+                if (DBufPuts(&fullname, DBufValue(&buf)) != OK) {
+                    r = E_NO_MEM;
+                    goto bailout;
+                }
+                s = DBufValue(&fullname);
+            } else {
+                s = DBufValue(&buf);
+            }
+        }
+    } else {
+        s = DBufValue(&buf);
+    }
+    if ( (r=IncludeFile(s)) ) {
+        goto bailout;
+    }
+
+  bailout:
+    DBufFree(&buf);
+    DBufFree(&path);
+    DBufFree(&fullname);
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SplitCmdDepends                                            */
+/*                                                             */
+/*  If line is of the form DEPENDS "file" ["file"...] cmd,     */
+/*  terminate the quoted file names in place, store pointers   */
+/*  to them in a newly-allocated *depnames and return the      */
+/*  number of them, leaving *cmd pointing at the command.      */
+/*  Otherwise, return 0 and leave the whole line as the        */
+/*  command.  Returns -1 if we run out of memory.              */
+/*                                                             */
+/***************************************************************/
+static int SplitCmdDepends(char *line, char **cmd, char const ***depnames)
+{
+    char *s = line;
+    char *end;
+    char const **names = NULL, **newnames;
+    int n = 0, max = 0;
+
+    *cmd = line;
+    *depnames = NULL;
+    if (strncasecmp(s, "depends", 7) || !isspace((unsigned char) s[7])) {
+        return 0;
+    }
+    s += 7;
+    while (1) {
+        while (isspace((unsigned char) *s)) s++;
+        if (*s != '"') break;
+        end = strchr(s+1, '"');
+        if (!end) break;
+        if (n == max) {
+            max = max ? max * 2 : 4;
+            newnames = realloc(names, max * sizeof(char const *));
+            if (!newnames) {
+                free(names);
+                return -1;
+            }
+            names = newnames;
+        }
+        *end = 0;
+        names[n++] = s+1;
+        s = end+1;
+    }
+    if (!n || !*s) {
+        /* Not a DEPENDS clause after all; put back the quotes */
+        while (n--) {
+            ((char *) names[n])[strlen(names[n])] = '"';
+        }
+        free(names);
+        return 0;
+    }
+    *cmd = s;
+    *depnames = names;
+    return n;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoIncludeCmd                                               */
+/*                                                             */
+/*  The INCLUDECMD command.                                    */
+/*                                                             */
+/***************************************************************/
+int DoIncludeCmd(ParsePtr p)
+{
+    DynamicBuffer buf;
+    int r;
+    int ch;
+    char append_buf[2];
+    int seen_nonspace = 0;
+    char *cmd;
+    char const **depnames;
+    int ndeps;
+
+    append_buf[1] = 0;
+
+    DBufInit(&buf);
+
+    while(1) {
+        ch = ParseChar(p, &r, 0);
+        if (r) {
+            DBufFree(&buf);
+            return r;
+        }
+        if (!ch) {
+            break;
+        }
+        if (isspace(ch) && !seen_nonspace) {
+            continue;
         }
         seen_nonspace = 1;
         /* Convert \n to ' ' to better handle line continuation */
@@ -851,23 +2208,25 @@ int DoIncludeCmd(ParsePtr p)
         return E_RUN_DISABLED;
     }
 
-    if ( (r=IncludeCmd(DBufValue(&buf))) ) {
+    ndeps = SplitCmdDepends(DBufValue(&buf), &cmd, &depnames);
+    if (ndeps < 0) {
         DBufFree(&buf);
-        return r;
+        return E_NO_MEM;
     }
+    r = IncludeCmd(cmd, depnames, ndeps);
+    free(depnames);
     DBufFree(&buf);
-    return OK;
+    return r;
 }
 
 #ifdef HAVE_GLOB
+static int GlobRemFiles(char const *dir, FilenameChain **chain);
+
 static int SetupGlobChain(char const *dirname, IncludeStruct *i)
 {
-    DynamicBuffer pattern;
     char *dir;
     size_t l;
     int r;
-    glob_t glob_buf;
-    struct stat sb;
 
     DirectoryFilenameChain *dc = CachedDirectoryChains;
 
@@ -934,10 +2293,32 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
         }
     }
 
+    r = GlobRemFiles(dir, &i->chain);
+    free(dir);
+    if (r == OK && dc) {
+        dc->chain = i->chain;
+    }
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  GlobRemFiles                                               */
+/*                                                             */
+/*  Make a sorted chain of the *.rem files in a directory.     */
+/*                                                             */
+/***************************************************************/
+static int GlobRemFiles(char const *dir, FilenameChain **chain)
+{
+    DynamicBuffer pattern;
+    int r;
+    glob_t glob_buf;
+    struct stat sb;
+
+    *chain = NULL;
     DBufInit(&pattern);
     DBufPuts(&pattern, dir);
     DBufPuts(&pattern, "/*.rem");
-    free(dir);
 
     r = glob(DBufValue(&pattern), 0, NULL, &glob_buf);
     DBufFree(&pattern);
@@ -967,29 +2348,52 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
         FilenameChain *ch = malloc(sizeof(FilenameChain));
         if (!ch) {
             globfree(&glob_buf);
-            FreeChain(i->chain);
-            i->chain = NULL;
+            FreeChain(*chain);
+            *chain = NULL;
             return E_NO_MEM;
         }
 
         ch->filename = strdup(glob_buf.gl_pathv[r]);
         if (!ch->filename) {
             globfree(&glob_buf);
-            FreeChain(i->chain);
-            i->chain = NULL;
+            FreeChain(*chain);
+            *chain = NULL;
             free(ch);
             return E_NO_MEM;
         }
-        ch->next = i->chain;
-        i->chain = ch;
-    }
-    if (dc) {
-        dc->chain = i->chain;
+        ch->next = *chain;
+        *chain = ch;
     }
 
     globfree(&glob_buf);
     return OK;
 }
+
+/***************************************************************/
+/*                                                             */
+/*  DirectoryChanged                                           */
+/*                                                             */
+/*  Has the list of *.rem files in a cached directory changed? */
+/*                                                             */
+/***************************************************************/
+static int DirectoryChanged(DirectoryFilenameChain const *dc)
+{
+    FilenameChain *chain, *a;
+    FilenameChain const *b;
+    int changed = 0;
+
+    if (GlobRemFiles(dc->dirname, &chain) != OK) {
+        return 1;
+    }
+    for (a = chain, b = dc->chain; a || b; a = a->next, b = b->next) {
+        if (!a || !b || strcmp(a->filename, b->filename)) {
+            changed = 1;
+            break;
+        }
+    }
+    FreeChain(chain);
+    return changed;
+}
 #endif
 
 /***************************************************************/
@@ -997,10 +2401,11 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
 /*  IncludeCmd                                                 */
 /*                                                             */
 /*  Process the INCLUDECMD command - actually do the command   */
-/*  inclusion.                                                 */
+/*  inclusion.  If the command's output depends only on the    */
+/*  ndeps files in depnames, it is kept until they change.     */
 /*                                                             */
 /***************************************************************/
-static int IncludeCmd(char const *cmd)
+static int IncludeCmd(char const *cmd, char const **depnames, int ndeps)
 {
     IncludeStruct *i;
     DynamicBuffer buf;
@@ -1010,6 +2415,9 @@ static int IncludeCmd(char const *cmd)
     char const *fname;
     int old_flag;
     int stdin_dup, devnull;
+    CmdDepFile *deps = NULL;
+    int persist = 0;
+    int k;
 
     got_a_fresh_line();
     clear_callstack();
@@ -1028,7 +2436,11 @@ static int IncludeCmd(char const *cmd)
     }
     fname = DBufValue(&buf);
 
+    /* We can't tell when the output of a command changes */
+    DepBroken = 1;
+
     i->filename = FileName;
+    i->dep_file = DepCur ? DepCur->cf : NULL;
     i->ownedByMe = 1;
     i->LineNo = LineNo;
     i->LineNoStart = LineNo;
@@ -1067,6 +2479,39 @@ static int IncludeCmd(char const *cmd)
         h = h->next;
     }
 
+    /* Note what the files it depends on look like before we run
+       the command, so that a change while it runs is noticed */
+    if (ndeps) {
+        r = StatCmdDeps(depnames, ndeps, &deps);
+        if (r < 0) {
+            PopFile();
+            DBufFree(&buf);
+            return E_NO_MEM;
+        }
+        if (r == OK && ScriptCacheFile && !PurgeMode) {
+            persist = 1;
+            if (CacheCmdFromDisk(fname, deps, ndeps) == OK) {
+                FreeCmdDeps(deps, ndeps);
+                CLine = CachedFiles->cache;
+                SetCurrentFilename(fname);
+                DBufFree(&buf);
+                LineNo = 0;
+                LineNoStart = 0;
+                if (!CachedFiles->ownedByMe) {
+                    RunDisabled |= RUN_NOTOWNER;
+                } else {
+                    RunDisabled &= ~RUN_NOTOWNER;
+                }
+                if (FileName) return OK; else return E_NO_MEM;
+            }
+        } else if (r != OK) {
+            /* A dependency is missing, so we can't keep the output */
+            FreeCmdDeps(deps, ndeps);
+            deps = NULL;
+            ndeps = 0;
+        }
+    }
+
     if (DebugFlag & DB_TRACE_FILES) {
         fprintf(ErrFp, tr("Executing `%s' for INCLUDECMD and caching as `%s'"),
                 cmd, fname);
@@ -1099,6 +2544,7 @@ static int IncludeCmd(char const *cmd)
     if (!fp2) {
         PopFile();
         DBufFree(&buf);
+        FreeCmdDeps(deps, ndeps);
         if (stdin_dup >= 0) {
             (void) dup2(stdin_dup, STDIN_FILENO);
             (void) close(stdin_dup);
@@ -1126,6 +2572,16 @@ static int IncludeCmd(char const *cmd)
     DebugFlag = old_flag;
     if (r == OK) {
         fp = NULL;
+        CachedFiles->deps = deps;
+        CachedFiles->ndeps = ndeps;
+        /* Output we can't tell is stale stays out of the cache file */
+        for (k=0; k<ndeps; k++) {
+            if (deps[k].racy) CachedFiles->stat_racy = 1;
+        }
+        if (persist) {
+            CachedFiles->persist = 1;
+            DiskCacheDirty = 1;
+        }
         CLine = CachedFiles->cache;
         LineNo = 0;
         LineNoStart = 0;
@@ -1134,6 +2590,7 @@ static int IncludeCmd(char const *cmd)
         return OK;
     }
     DBufFree(&buf);
+    FreeCmdDeps(deps, ndeps);
     /* We failed */
     PopFile();
     return E_CANT_OPEN;
@@ -1165,6 +2622,7 @@ int IncludeFile(char const *fname)
     i->CLine = CLine;
     i->offset = -1L;
     i->chain = NULL;
+    i->dep_file = DepCur ? DepCur->cf : NULL;
     if (RunDisabled & RUN_NOTOWNER) {
         i->ownedByMe = 0;
     } else {
@@ -1185,6 +2643,7 @@ int IncludeFile(char const *fname)
         if (S_ISDIR(statbuf.st_mode)) {
             /* Check safety */
             if (!CheckSafetyAux(&statbuf)) {
+                DepBroken = 1;
                 PopFile();
                 return E_NO_MATCHING_REMS;
             }
@@ -1207,6 +2666,7 @@ int IncludeFile(char const *fname)
                     }
                     Eprint("%s: %s", GetErr(E_CANT_OPEN), fc->filename);
                     RunDisabled = oldRunDisabled;
+                    DepBroken = 1;
                 }
                 /* Couldn't open anything... bail */
                 return PopFile();
@@ -1214,6 +2674,7 @@ int IncludeFile(char const *fname)
                 if (!Hush) {
                     Eprint("%s: %s", fname, GetErr(E_NO_MATCHING_REMS));
                 }
+                DepBroken = 1;
             }
             return E_NO_MATCHING_REMS;
         }
@@ -1228,6 +2689,7 @@ int IncludeFile(char const *fname)
     RunDisabled = oldRunDisabled;
     Eprint("%s: %s", GetErr(E_CANT_OPEN), fname);
     /* Ugh!  We failed!  */
+    DepBroken = 1;
     PopFile();
     return E_CANT_OPEN;
 }
@@ -1240,10 +2702,11 @@ int IncludeFile(char const *fname)
 int GetAccessDate(char const *file)
 {
     struct stat statbuf;
+    struct tm tm1;
     struct tm const *t1;
 
     if (stat(file, &statbuf)) return -1;
-    t1 = localtime(&(statbuf.st_atime));
+    t1 = tz_localtime_r(&(statbuf.st_atime), &tm1);
 
     if (t1->tm_year + 1900 < BASE)
         return 0;
@@ -1262,10 +2725,19 @@ static void DestroyCache(CachedFile *cf)
 {
     CachedLine *cl, *cnext;
     CachedFile *temp;
+    int i;
+
+    for (i=0; i<NumDepSegments; i++) {
+        if (DepSegments[i].cf == cf) DepSegments[i].cf = NULL;
+    }
+    if (DepRerunSeg.cf == cf) DepRerunSeg.cf = NULL;
     if (cf->filename) free((char *) cf->filename);
+    FreeCmdDeps(cf->deps, cf->ndeps);
     cl = cf->cache;
     while (cl) {
-        if (cl->text) free ((char *) cl->text);
+        if (cl == CurCachedLine) CurCachedLine = NULL;
+        if (cl->text && !cf->mapped) free ((char *) cl->text);
+        if (cl->compiled) FreeCompiledRem(cl->compiled);
         cnext = cl->next;
         free(cl);
         cl = cnext;
@@ -26,6 +26,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -227,7 +228,7 @@ static int FWkday          (func_info *);
 static int FWkdaynum       (func_info *);
 static int FYear           (func_info *);
 
-static int SunStuff        (int rise, double cosz, int dse);
+static int SunStuff        (int rise, double cosz, int dse, int mins);
 
 /* Caches for extracting months, days, years from dates - may
    improve performance slightly. */
@@ -450,12 +451,7 @@ static int get_month(Value *v)
 static int RetStrVal(char const *s, func_info *info)
 {
     RetVal.type = STR_TYPE;
-    if (!s) {
-        RetVal.v.str = malloc(1);
-        if (RetVal.v.str) *RetVal.v.str = 0;
-    } else {
-        RetVal.v.str = strdup(s);
-    }
+    RetVal.v.str = DupStr(s ? s : "");
 
     if (!RetVal.v.str) {
         RetVal.type = ERR_TYPE;
@@ -793,38 +789,35 @@ static int FCodepoint(func_info *info)
 static int FChar(func_info *info)
 {
 
-    int i, len;
+    int i;
+    char buf[2];
 
 /* Special case of one arg - if given ascii value 0, create empty string */
     if (Nargs == 1) {
         ASSERT_TYPE(0, INT_TYPE);
         if (ARGV(0) < -128) return E_2LOW;
         if (ARGV(0) > 255) return E_2HIGH;
-        len = ARGV(0) ? 2 : 1;
-        RetVal.v.str = malloc(len);
-        if (!RetVal.v.str) return E_NO_MEM;
-        RetVal.type = STR_TYPE;
-        *(RetVal.v.str) = ARGV(0);
-        if (len>1) *(RetVal.v.str + 1) = 0;
-        return OK;
+        buf[0] = ARGV(0);
+        buf[1] = 0;
+        return RetStrVal(buf, info);
     }
 
-    RetVal.v.str = malloc(Nargs + 1);
+    RetVal.v.str = AllocStr(Nargs);
     if (!RetVal.v.str) return E_NO_MEM;
     RetVal.type = STR_TYPE;
     for (i=0; i<Nargs; i++) {
         if (ARG(i).type != INT_TYPE) {
-            free(RetVal.v.str);
+            ReleaseStr(RetVal.v.str);
             RetVal.type = ERR_TYPE;
             return E_BAD_TYPE;
         }
         if (ARG(i).v.val < -128 || ARG(i).v.val == 0) {
-            free(RetVal.v.str);
+            ReleaseStr(RetVal.v.str);
             RetVal.type = ERR_TYPE;
             return E_2LOW;
         }
         if (ARG(i).v.val > 255) {
-            free(RetVal.v.str);
+            ReleaseStr(RetVal.v.str);
             RetVal.type = ERR_TYPE;
             return E_2HIGH;
         }
@@ -876,7 +869,7 @@ static int FMbchar(func_info *info)
         return E_BAD_MB_SEQ;
     }
 
-    s = malloc(len+1);
+    s = AllocStr(len);
     if (!s) {
         free( (void *) arr);
         return E_NO_MEM;
@@ -1280,7 +1273,7 @@ static int FAmpm(func_info *info)
         ampm = pm;
     }
     RetVal.type = STR_TYPE;
-    RetVal.v.str = malloc(strlen(outbuf) + strlen(ampm) + 1);
+    RetVal.v.str = AllocStr(strlen(outbuf) + strlen(ampm));
     if (!RetVal.v.str) {
         RetVal.type = ERR_TYPE;
         return E_NO_MEM;
@@ -1581,7 +1574,7 @@ static int FPlural(func_info *info)
             return OK;
         }
         RetVal.type = STR_TYPE;
-        RetVal.v.str = malloc(strlen(ARGSTR(1))+2);
+        RetVal.v.str = AllocStr(strlen(ARGSTR(1))+1);
         if (!RetVal.v.str) {
             RetVal.type = ERR_TYPE;
             return E_NO_MEM;
@@ -1903,6 +1896,7 @@ static int FUpper(func_info *info)
 
     ASSERT_TYPE(0, STR_TYPE);
     DCOPYVAL(RetVal, ARG(0));
+    if (MakeStrUnique(&RetVal) != OK) return E_NO_MEM;
     s = RetVal.v.str;
     while (*s) {
         *s = UPPER(*s);
@@ -1917,6 +1911,7 @@ static int FLower(func_info *info)
 
     ASSERT_TYPE(0, STR_TYPE);
     DCOPYVAL(RetVal, ARG(0));
+    if (MakeStrUnique(&RetVal) != OK) return E_NO_MEM;
     s = RetVal.v.str;
     while (*s) {
         *s = LOWER(*s);
@@ -2059,6 +2054,7 @@ static int FValue(expr_node *node, Value *locals, Value *ans, int *nonconst)
         return E_BAD_TYPE;
     }
 
+    DepRead('v', varname.v.str);
     v = FindVar(varname.v.str, 0);
     if (!v) {
         r = E_NOSUCH_VAR;
@@ -2124,6 +2120,7 @@ static int FDefined(func_info *info)
 
     RetVal.type = INT_TYPE;
 
+    DepRead('v', ARGSTR(0));
     if (FindVar(ARGSTR(0), 0))
         RETVAL = 1;
     else
@@ -2518,6 +2515,151 @@ static int FTrigger(func_info *info)
     return RetStrVal(buf, info);
 }
 
+/* Cached results of shell() calls; see $ShellCache.  An entry
+   with expires == 0 lasts until the reminders are reloaded */
+typedef struct shell_cache_entry {
+    struct hash_link link;
+    char *cmd;
+    int maxlen;
+    time_t expires;
+    char *output;
+} ShellCacheEntry;
+
+static hash_table ShellCacheTable;
+static int ShellCacheInited = 0;
+static unsigned long ShellCacheHits = 0;
+static unsigned long ShellCacheMisses = 0;
+
+static unsigned int ShellCacheHashFunc(void const *x)
+{
+    ShellCacheEntry const *e = (ShellCacheEntry const *) x;
+    return HashVal_preservecase(e->cmd) + (unsigned int) e->maxlen;
+}
+
+static int CompareShellCacheEntries(void const *x, void const *y)
+{
+    ShellCacheEntry const *a = (ShellCacheEntry const *) x;
+    ShellCacheEntry const *b = (ShellCacheEntry const *) y;
+    if (a->maxlen != b->maxlen) return a->maxlen - b->maxlen;
+    return strcmp(a->cmd, b->cmd);
+}
+
+static void FreeShellCacheEntry(ShellCacheEntry *e)
+{
+    free(e->cmd);
+    free(e->output);
+    free(e);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ClearShellCache                                            */
+/*                                                             */
+/*  Forget cached shell() results, except the ones that were   */
+/*  cached with a time limit that has not yet run out.         */
+/*                                                             */
+/***************************************************************/
+void ClearShellCache(void)
+{
+    ShellCacheEntry *e, *next;
+    time_t now;
+
+    if (!ShellCacheInited) return;
+    now = time(NULL);
+    e = hash_table_next(&ShellCacheTable, NULL);
+    while(e) {
+        next = hash_table_next(&ShellCacheTable, e);
+        if (!e->expires || e->expires <= now) {
+            hash_table_delete_no_resize(&ShellCacheTable, e);
+            FreeShellCacheEntry(e);
+        }
+        e = next;
+    }
+}
+
+/* Look up a cached result, throwing it away if it has expired */
+static ShellCacheEntry *FindShellCacheEntry(char const *cmd, int maxlen)
+{
+    ShellCacheEntry candidate, *e;
+
+    if (!ShellCacheInited) {
+        if (hash_table_init(&ShellCacheTable,
+                            offsetof(ShellCacheEntry, link),
+                            ShellCacheHashFunc, CompareShellCacheEntries) < 0) {
+            return NULL;
+        }
+        ShellCacheInited = 1;
+    }
+    candidate.cmd = (char *) cmd;
+    candidate.maxlen = maxlen;
+    e = hash_table_find(&ShellCacheTable, &candidate);
+    if (e && e->expires && e->expires <= time(NULL)) {
+        hash_table_delete(&ShellCacheTable, e);
+        FreeShellCacheEntry(e);
+        e = NULL;
+    }
+    return e;
+}
+
+static void InsertShellCacheEntry(char const *cmd, int maxlen, char const *output)
+{
+    ShellCacheEntry *e;
+
+    if (!ShellCacheInited) return;
+    e = malloc(sizeof(ShellCacheEntry));
+    if (!e) return;
+    e->cmd = strdup(cmd);
+    e->output = strdup(output);
+    if (!e->cmd || !e->output) {
+        free(e->cmd);
+        free(e->output);
+        free(e);
+        return;
+    }
+    e->maxlen = maxlen;
+    e->expires = (ShellCache > 0) ? time(NULL) + ShellCache : 0;
+    if (hash_table_insert(&ShellCacheTable, e) < 0) {
+        FreeShellCacheEntry(e);
+    }
+}
+
+void print_shell_cache_stats(void)
+{
+    fprintf(ErrFp, "shell() cache: %lu hits; %lu misses\n",
+            ShellCacheHits, ShellCacheMisses);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ReadShellOutput                                            */
+/*                                                             */
+/*  Read up to maxlen characters (no limit if maxlen <= 0)     */
+/*  from fp into buf, converting whitespace to spaces.         */
+/*                                                             */
+/***************************************************************/
+static int ReadShellOutput(FILE *fp, int maxlen, DynamicBuffer *buf)
+{
+    char chunk[512];
+    size_t want, n, i;
+
+    while (1) {
+        want = sizeof(chunk);
+        if (maxlen > 0) {
+            if (DBufLen(buf) >= (size_t) maxlen) break;
+            if (want > (size_t) maxlen - DBufLen(buf)) {
+                want = (size_t) maxlen - DBufLen(buf);
+            }
+        }
+        n = fread(chunk, 1, want, fp);
+        if (!n) break;
+        for (i=0; i<n; i++) {
+            if (isspace((unsigned char) chunk[i])) chunk[i] = ' ';
+            if (DBufPutc(buf, chunk[i]) != OK) return E_NO_MEM;
+        }
+    }
+    return OK;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  FShell                                                     */
@@ -2530,8 +2672,9 @@ static int FTrigger(func_info *info)
 static int FShell(func_info *info)
 {
     DynamicBuffer buf;
-    int ch, r;
+    int r;
     FILE *fp;
+    ShellCacheEntry *e;
 
     /* For compatibility with previous versions of Remind, which
        used a static buffer for reading results from shell() command */
@@ -2557,6 +2700,15 @@ static int FShell(func_info *info)
         }
     }
 
+    if (ShellCache) {
+        e = FindShellCacheEntry(ARGSTR(0), maxlen);
+        if (e) {
+            ShellCacheHits++;
+            return RetStrVal(e->output, info);
+        }
+        ShellCacheMisses++;
+    }
+
     stdin_dup = dup(STDIN_FILENO);
     if (stdin_dup >= 0) {
         devnull = open("/dev/null", O_RDONLY);
@@ -2579,24 +2731,15 @@ static int FShell(func_info *info)
         }
         return E_IO_ERR;
     }
-    while (1) {
-        ch = getc(fp);
-        if (ch == EOF) {
-            break;
-        }
-        if (isspace(ch)) ch = ' ';
-        if (DBufPutc(&buf, (char) ch) != OK) {
-            pclose(fp);
-            if (stdin_dup >= 0) {
-                (void) dup2(stdin_dup, STDIN_FILENO);
-                (void) close(stdin_dup);
-            }
-            DBufFree(&buf);
-            return E_NO_MEM;
-        }
-        if (maxlen > 0 && DBufLen(&buf) >= (size_t) maxlen) {
-            break;
+    r = ReadShellOutput(fp, maxlen, &buf);
+    if (r != OK) {
+        pclose(fp);
+        if (stdin_dup >= 0) {
+            (void) dup2(stdin_dup, STDIN_FILENO);
+            (void) close(stdin_dup);
         }
+        DBufFree(&buf);
+        return r;
     }
 
     /* Delete trailing newline (converted to space) */
@@ -2611,6 +2754,9 @@ static int FShell(func_info *info)
         (void) dup2(stdin_dup, STDIN_FILENO);
         (void) close(stdin_dup);
     }
+    if (ShellCache) {
+        InsertShellCacheEntry(ARGSTR(0), maxlen, DBufValue(&buf));
+    }
     r = RetStrVal(DBufValue(&buf), info);
     DBufFree(&buf);
     return r;
@@ -2642,7 +2788,7 @@ static int FIsomitted(func_info *info)
 /***************************************************************/
 static int FSubstr(func_info *info)
 {
-    char *s;
+    char const *s;
     char const *t;
     int start, end;
 
@@ -2664,8 +2810,12 @@ static int FSubstr(func_info *info)
         s++;
         end++;
     }
-    *s = 0;
-    return RetStrVal(t, info);
+    RetVal.v.str = AllocStr(s - t);
+    if (!RetVal.v.str) return E_NO_MEM;
+    RetVal.type = STR_TYPE;
+    memcpy(RetVal.v.str, t, s - t);
+    RetVal.v.str[s - t] = 0;
+    return OK;
 }
 
 /***************************************************************/
@@ -2721,7 +2871,7 @@ static int FMbsubstr(func_info *info)
         free( (void *) str);
         return E_BAD_MB_SEQ;
     }
-    converted = malloc(len+1);
+    converted = AllocStr(len);
     if (!converted) {
         free( (void *) str);
         return E_NO_MEM;
@@ -3037,6 +3187,7 @@ static int FLanguage(func_info *info)
 static int FArgs(func_info *info)
 {
     ASSERT_TYPE(0, STR_TYPE);
+    if (MakeStrUnique(&ARG(0)) != OK) return E_NO_MEM;
     RetVal.type = INT_TYPE;
     strtolower(ARGSTR(0));
     RETVAL = UserFuncExists(ARGSTR(0));
@@ -3554,7 +3705,6 @@ static int FTimezone(func_info *info)
 {
     int yr, mon, day, hr, min, dse, now;
     struct tm local;
-    struct tm const * withzone;
     time_t t;
     char buf[64];
 
@@ -3583,10 +3733,8 @@ static int FTimezone(func_info *info)
     local.tm_year = yr-1900;
     local.tm_isdst = -1;
 
-    t = mktime(&local);
-    withzone = localtime(&t);
-    buf[0] = 0;
-    strftime(buf, sizeof(buf), "%Z", withzone);
+    t = tz_mktime(&local);
+    tz_abbrev(t, buf, sizeof(buf));
     return RetStrVal(buf, info);
 }
 
@@ -3613,7 +3761,7 @@ static int FLocalToUTC(func_info *info)
     local.tm_mon = mon;
     local.tm_year = yr-1900;
     local.tm_isdst = -1;
-    loc_t = mktime(&local);
+    loc_t = tz_mktime(&local);
     if (loc_t == -1) {
         /* Try folding the year */
         wkday = DSE(yr, 0, 1) % 7;
@@ -3627,7 +3775,7 @@ static int FLocalToUTC(func_info *info)
         local.tm_mon = mon;
         local.tm_year = fold_year-1900;
         local.tm_isdst = -1;
-        loc_t = mktime(&local);
+        loc_t = tz_mktime(&local);
         if (loc_t == -1) {
             /* Still no joy */
             return E_MKTIME_PROBLEM;
@@ -3651,8 +3799,7 @@ static int UTCToLocalHelper(int datetime, int *ret)
 {
     int yr, mon, day, hr, min, dse;
     time_t utc_t;
-    struct tm *local, utc;
-    char const *old_tz;
+    struct tm local, utc;
     int fold_year = -1;
     int isleap, wkday;
 
@@ -3660,14 +3807,6 @@ static int UTCToLocalHelper(int datetime, int *ret)
     hr =  (datetime % MINUTES_PER_DAY) / 60;
     min = (datetime % MINUTES_PER_DAY) % 60;
 
-    old_tz = getenv("TZ");
-    if (old_tz) {
-        old_tz = strdup(old_tz);
-        if (!old_tz) return E_NO_MEM;
-    }
-
-    tz_set_tz("UTC");
-
     memset(&utc, 0, sizeof(utc));
     utc.tm_sec = 0;
     utc.tm_min = min;
@@ -3676,7 +3815,7 @@ static int UTCToLocalHelper(int datetime, int *ret)
     utc.tm_mon = mon;
     utc.tm_year = yr-1900;
     utc.tm_isdst = 0;
-    utc_t = mktime(&utc);
+    utc_t = tz_mktime_in("UTC", &utc);
 
     if (utc_t == -1) {
         /* Try folding the year */
@@ -3691,22 +3830,18 @@ static int UTCToLocalHelper(int datetime, int *ret)
         utc.tm_mon = mon;
         utc.tm_year = fold_year-1900;
         utc.tm_isdst = 0;
-        utc_t = mktime(&utc);
-    }
-    tz_set_tz(old_tz);
-    if (old_tz) {
-        free( (void *) old_tz);
+        utc_t = tz_mktime_in("UTC", &utc);
     }
     if (utc_t == -1) {
         return E_MKTIME_PROBLEM;
     }
 
-    local = localtime(&utc_t);
+    (void) tz_localtime_r(&utc_t, &local);
     if (fold_year > 0) {
-        local->tm_year = yr + local->tm_year - fold_year; /* The two 1900s cancel */
+        local.tm_year = yr + local.tm_year - fold_year; /* The two 1900s cancel */
     }
-    dse = DSE(local->tm_year+1900, local->tm_mon, local->tm_mday);
-    *ret = MINUTES_PER_DAY * dse + local->tm_hour*60 + local->tm_min;
+    dse = DSE(local.tm_year+1900, local.tm_mon, local.tm_mday);
+    *ret = MINUTES_PER_DAY * dse + local.tm_hour*60 + local.tm_min;
     return OK;
 }
 
@@ -3745,28 +3880,17 @@ static int FUTCToLocal(func_info *info)
 #define DEGRAD (PI/180.0)
 #define RADDEG (180.0/PI)
 
-static int SunStuff(int rise, double cosz, int dse)
+static int SunStuff(int rise, double cosz, int dse, int mins)
 {
-    int mins, hours;
-    int year, mon, day;
+    int hours;
 
     double M, L, sinDelta, cosDelta, a, a_hr, cosH, t, H, T;
     double latitude, longdeg, UT, local;
 
-/* Get offset from UTC */
-    if (CalculateUTC) {
-        if (CalcMinsFromUTC(dse, 12*60, &mins, NULL)) {
-            Eprint(GetErr(E_MKTIME_PROBLEM));
-            return NO_TIME;
-        }
-    } else mins = MinsFromUTC;
-
 /* Get latitude and longitude */
     longdeg = -Longitude;
     latitude = DEGRAD * Latitude;
 
-    FromDSE(dse, &year, &mon, &day);
-
 /* Following formula on page B6 exactly... */
     t = (double) dse;
     if (rise) {
@@ -3848,6 +3972,91 @@ static int SunStuff(int rise, double cosz, int dse)
     return hours*60 + mins;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  Solar event cache.                                         */
+/*                                                             */
+/*  Calendars and -s output evaluate sunrise() and friends for */
+/*  every day, often several at once.  Results are remembered  */
+/*  per day, together with that day's UTC offset so that the   */
+/*  mktime() round-trip happens only once per day.  The whole  */
+/*  cache is dropped when the location or time zone changes.   */
+/*                                                             */
+/***************************************************************/
+#define SUN_CACHE_DAYS 366
+#define SUN_NUM_EVENTS 8
+
+/* Cosine of the zenith angle for each pair of events */
+static double const SunCosZ[SUN_NUM_EVENTS / 2] = {
+    -0.01454389765158243, /* Sunrise and sunset: cos(90 degrees + 50 arcminutes) */
+    -0.10452846326765333, /* Civil twilight: cos(96 degrees) */
+    -0.20791169081775912, /* Nautical twilight: cos(102 degrees) */
+    -0.30901699437494734  /* Astronomical twilight: cos(108 degrees) */
+};
+
+typedef struct {
+    int dse;                    /* -1 if the slot is empty */
+    int mins;                   /* Offset from UTC at noon */
+    unsigned char have;         /* Bitmask of events computed */
+    int events[SUN_NUM_EVENTS];
+} SunDay;
+
+static SunDay SunCache[SUN_CACHE_DAYS];
+static int SunCacheValid = 0;
+static double SunCacheLatitude, SunCacheLongitude;
+static int SunCacheCalculateUTC, SunCacheMinsFromUTC;
+static unsigned int SunCacheTzGeneration;
+
+static void SunCacheCheck(void)
+{
+    int i;
+
+    if (SunCacheValid &&
+        SunCacheLatitude == Latitude &&
+        SunCacheLongitude == Longitude &&
+        SunCacheCalculateUTC == CalculateUTC &&
+        SunCacheMinsFromUTC == MinsFromUTC &&
+        SunCacheTzGeneration == TzGeneration) {
+        return;
+    }
+    for (i=0; i<SUN_CACHE_DAYS; i++) {
+        SunCache[i].dse = -1;
+    }
+    SunCacheLatitude = Latitude;
+    SunCacheLongitude = Longitude;
+    SunCacheCalculateUTC = CalculateUTC;
+    SunCacheMinsFromUTC = MinsFromUTC;
+    SunCacheTzGeneration = TzGeneration;
+    SunCacheValid = 1;
+}
+
+/* Return solar event number "which" (as passed to FSun) on day dse */
+static int SunEvent(int which, int dse)
+{
+    SunDay *day;
+    int mins;
+
+    SunCacheCheck();
+    day = &SunCache[dse % SUN_CACHE_DAYS];
+    if (day->dse != dse) {
+        /* Get offset from UTC */
+        if (CalculateUTC) {
+            if (CalcMinsFromUTC(dse, 12*60, &mins, NULL)) {
+                Eprint(GetErr(E_MKTIME_PROBLEM));
+                return NO_TIME;
+            }
+        } else mins = MinsFromUTC;
+        day->dse = dse;
+        day->mins = mins;
+        day->have = 0;
+    }
+    if (!(day->have & (1 << which))) {
+        day->events[which] = SunStuff(which % 2, SunCosZ[which / 2], dse, day->mins);
+        day->have |= (1 << which);
+    }
+    return day->events[which];
+}
+
 /***************************************************************/
 /*                                                             */
 /*  Sunrise and Sunset functions.                              */
@@ -3856,34 +4065,18 @@ static int SunStuff(int rise, double cosz, int dse)
 static int FSun(int rise, func_info *info)
 {
     int dse = DSEToday;
-    /* Assignment below is not necessary, but it silences
-       a GCC warning about a possibly-uninitialized variable */
-    double cosz = 0.0;
     int r;
 
     /* Sun calculations assume BASE is 1990 */
     if (BASE != 1990) {
         return E_SWERR;
     }
-    if (rise == 0 || rise == 1) {
-    /* Sunrise and sunset : cos(90 degrees + 50 arcminutes) */
-    cosz = -0.01454389765158243;
-    } else if (rise == 2 || rise == 3) {
-    /* Civil twilight: cos(96 degrees) */
-        cosz = -0.10452846326765333;
-    } else if (rise == 4 || rise == 5) {
-    /* Nautical twilight: cos(102 degrees) */
-        cosz = -0.20791169081775912;
-    } else if (rise == 6 || rise == 7) {
-    /* Astronomical twilight: cos(108 degrees) */
-        cosz = -0.30901699437494734;
-    }
     if (Nargs >= 1) {
         if (!HASDATE(ARG(0))) return E_BAD_TYPE;
         dse = DATEPART(ARG(0));
     }
 
-    r = SunStuff(rise % 2, cosz, dse);
+    r = SunEvent(rise, dse);
     if (r == NO_TIME) {
         RETVAL = 0;
         RetVal.type = INT_TYPE;
@@ -3943,6 +4136,7 @@ static int FADusk(func_info *info)
 static int FFiledate(func_info *info)
 {
     struct stat statbuf;
+    struct tm tm1;
     struct tm const *t1;
 
     RetVal.type = DATE_TYPE;
@@ -3954,7 +4148,7 @@ static int FFiledate(func_info *info)
         return OK;
     }
 
-    t1 = localtime(&(statbuf.st_mtime));
+    t1 = tz_localtime_r(&(statbuf.st_mtime), &tm1);
 
     if (t1->tm_year + 1900 < BASE)
         RETVAL=0;
@@ -3974,6 +4168,7 @@ static int FFiledate(func_info *info)
 static int FFiledatetime(func_info *info)
 {
     struct stat statbuf;
+    struct tm tm1;
     struct tm const *t1;
 
     RetVal.type = DATETIME_TYPE;
@@ -3985,7 +4180,7 @@ static int FFiledatetime(func_info *info)
         return OK;
     }
 
-    t1 = localtime(&(statbuf.st_mtime));
+    t1 = tz_localtime_r(&(statbuf.st_mtime), &tm1);
 
     if (t1->tm_year + 1900 < BASE)
         RETVAL=0;
@@ -4387,10 +4582,8 @@ int tz_convert(int year, int month, int day,
                       char const *src_tz, char const *tgt_tz,
                       struct tm *tm)
 {
-    int r;
     time_t t;
     struct tm const *res;
-    char const *old_tz;
 
     /* init tm struct */
     tm->tm_sec = 0;
@@ -4399,54 +4592,26 @@ int tz_convert(int year, int month, int day,
     tm->tm_mday = day;
     tm->tm_mon = month;
     tm->tm_year = year - 1900;
-    tm->tm_wday = 0; /* ignored by mktime */
-    tm->tm_yday = 0; /* ignored by mktime */
+    tm->tm_wday = 0; /* ignored by tz_mktime_in */
+    tm->tm_yday = 0; /* ignored by tz_mktime_in */
     tm->tm_isdst = -1;  /* information not available */
 
-    /* backup old TZ env var */
-    old_tz = getenv("TZ");
-    if (old_tz) {
-        old_tz = strdup(old_tz);
-        if (!old_tz) return E_NO_MEM;
-    }
+    /* An unspecified zone means the one currently in effect */
     if (tgt_tz == NULL || !*tgt_tz) {
-        tgt_tz = old_tz;
+        tgt_tz = tz_get_active();
     }
     if (src_tz == NULL || !*src_tz) {
-        src_tz = old_tz;
-    }
-
-    /* set source TZ */
-    r = tz_set_tz(src_tz);
-    if (r == -1) {
-        tz_set_tz(old_tz);
-        if (old_tz) free((void *) old_tz);
-        return -1;
+        src_tz = tz_get_active();
     }
 
     /* create timestamp in UTC */
-    t = mktime(tm);
-
+    t = tz_mktime_in(src_tz, tm);
     if (t == (time_t) -1) {
-        tz_set_tz(old_tz);
-        if (old_tz) free((void *) old_tz);
-        return -1;
-    }
-
-    /* set target TZ */
-    r = tz_set_tz(tgt_tz);
-    if (r == -1) {
-        tz_set_tz(old_tz);
-        if (old_tz) free((void *) old_tz);
         return -1;
     }
 
     /* convert to target TZ */
-    res = localtime_r(&t, tm);
-
-    /* restore old TZ */
-    tz_set_tz(old_tz);
-    if (old_tz) free((void *) old_tz);
+    res = tz_localtime_in(tgt_tz, &t, tm);
 
     /* return result */
     if (res == NULL) {
@@ -4536,7 +4701,11 @@ FSlide(func_info *info)
 
     /* If ALL weekdays are omitted... barf! */
     if ((WeekdayOmits | localomit) == 0x7F && amt != 0) return E_2MANY_LOCALOMIT;
-    if (amt > 0) {
+    if (step == 1) {
+        /* Fast path: scan the OMIT bitmaps a word at a time */
+        d = SlideNonOmitted(d, amt, localomit, INT_MAX);
+        if (d < 0) return E_DATE_OVER;
+    } else if (amt > 0) {
         while(amt) {
             d += step;
             r = IsOmitted(d, localomit, NULL, &omit);
@@ -4592,6 +4761,13 @@ FNonomitted(func_info *info)
         localomit |= (1 << tok.val);
     }
 
+    if (step == 1) {
+        /* Fast path: count a word of the OMIT bitmaps at a time */
+        RetVal.type = INT_TYPE;
+        RETVAL = CountNonOmitted(d1, d2, localomit);
+        return OK;
+    }
+
     ans = 0;
     while (d1 < d2) {
         r = IsOmitted(d1, localomit, NULL, &omit);
@@ -44,7 +44,7 @@ EXTERN  FILE *ErrFp;
 #define IsLeapYear(y) (((y) % 4) ? 0 : ((!((y) % 100) && ((y) % 400)) ? 0 : 1 ))
 #define DaysInMonth(m, y) ((m) != 1 ? MonthDays[m] : 28 + IsLeapYear(y))
 
-#define DestroyValue(x) do { if ((x).type == STR_TYPE && (x).v.str) { free((x).v.str); (x).v.str = NULL; } (x).type = ERR_TYPE; } while (0)
+#define DestroyValue(x) do { if ((x).type == STR_TYPE && (x).v.str) { ReleaseStr((x).v.str); (x).v.str = NULL; } (x).type = ERR_TYPE; } while (0)
 
 EXTERN  int     DSEToday;
 EXTERN  int     RealToday;
@@ -80,6 +80,7 @@ EXTERN  INIT(   int     PsCal, 0);
 EXTERN  INIT(   int     CalWidth, 80);
 EXTERN  INIT(   int     CalWeeks, 0);
 EXTERN  INIT(   int     CalMonths, 0);
+EXTERN  INIT(   int     CalWorkers, 0);
 EXTERN  INIT(   char const *CalType, "none");
 EXTERN  INIT(   int     Hush, 0);
 EXTERN  INIT(   int     NextMode, 0);
@@ -95,7 +96,6 @@ EXTERN  INIT(   unsigned long  ExpressionNodesEvaluated, 0);
 EXTERN  INIT(   unsigned long  MaxExprNodesPerLine, 0);
 EXTERN  INIT(   unsigned long  ExpressionNodesEvaluatedThisLine, 0);
 EXTERN  INIT(   unsigned long  ExpressionNodeLimitPerLine, 10000000);
-EXTERN  INIT(   volatile sig_atomic_t ExpressionTimeLimitExceeded, 0);
 EXTERN  INIT(   int     IgnoreOnce, 0);
 EXTERN  INIT(   char const *OnceFile, NULL);
 EXTERN  INIT(   int     OnceDate, -1);
@@ -109,6 +109,19 @@ EXTERN  INIT(   int     SysTime, -1);
 EXTERN  INIT(   int     LocalSysTime, -1);
 EXTERN  INIT(   int     ParseUntriggered, 0);
 EXTERN  INIT(   int     Shaded, 0);
+EXTERN  INIT(   int     CompileCalendar, 0);
+EXTERN  INIT(   char const *ScriptCacheFile, NULL);
+EXTERN  INIT(   int     NumWarnings, 0);
+
+/* Bumped whenever a variable or a user-defined function changes */
+EXTERN  INIT(   unsigned int VarGeneration, 0);
+EXTERN  INIT(   unsigned int FuncGeneration, 0);
+
+/* Bumped whenever a variable is deleted, invalidating bound expr_nodes */
+EXTERN  INIT(   unsigned int VarBindGeneration, 0);
+
+/* Bumped whenever the TZ environment variable is changed */
+EXTERN  INIT(   unsigned int TzGeneration, 0);
 
 EXTERN  char    const *InitialFile;
 EXTERN  char    const *LocalTimeZone;
@@ -132,6 +145,7 @@ EXTERN  INIT(   int     SynthesizeTags, 0);
 EXTERN  INIT(   int     ScFormat, SC_AMPM);
 EXTERN  INIT(   int     MaxSatIter, 10000);
 EXTERN  INIT(   int     MaxStringLen, MAX_STR_LEN);
+EXTERN  INIT(   int     ShellCache, 0);
 EXTERN  INIT(   int     UseStdin, 0);
 EXTERN  INIT(   int     PurgeMode, 0);
 EXTERN  INIT(   int     PurgeIncludeDepth, 0);
@@ -21,6 +21,7 @@
 #include "globals.h"
 #include "err.h"
 #include <string.h>
+#include <stdlib.h>
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -210,6 +211,96 @@ static char const *DaysInHebMonths(int ylen)
     return monlen;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  Year table                                                 */
+/*                                                             */
+/*  Rosh Hashana, year length and month lengths and offsets    */
+/*  for each Hebrew year, so that converting between Hebrew    */
+/*  dates and DSE is a lookup rather than molad arithmetic.    */
+/*  The table is filled lazily and grown to cover whatever     */
+/*  range of years is asked for.  Years outside Remind's date  */
+/*  range aren't tabulated; they're computed into a scratch    */
+/*  entry supplied by the caller.                              */
+/*                                                             */
+/***************************************************************/
+typedef struct {
+    int rh;                 /* DSE of 1 Tishrey */
+    int ylen;               /* Days in year; 0 if not filled yet */
+    char monlen[14];        /* As returned by DaysInHebMonths */
+    short mstart[14];       /* Offset of first of month from RH */
+} HebYearEntry;
+
+#define HEB_FIRST_YEAR (BASE+3760-1)
+#define HEB_LAST_YEAR  (BASE+YR_RANGE+3761+1)
+
+static HebYearEntry *HebYearTable = NULL;
+static int HebYearTableLo = 0;
+static int HebYearTableLen = 0;
+
+static void FillHebYear(int y, HebYearEntry *e)
+{
+    char const *monlen;
+    int m, off;
+
+    e->rh = RoshHashana(y);
+    e->ylen = RoshHashana(y+1) - e->rh;
+    monlen = DaysInHebMonths(e->ylen);
+    off = 0;
+    for (m=0; m<14; m++) {
+        e->monlen[m] = monlen[m];
+        e->mstart[m] = off;
+        off += monlen[m];
+    }
+}
+
+/* The returned pointer is only good until the next call */
+static HebYearEntry const *GetHebYear(int y, HebYearEntry *scratch)
+{
+    int lo, hi, len, i;
+    HebYearEntry *table, *e;
+
+    if (y < HEB_FIRST_YEAR || y > HEB_LAST_YEAR) {
+        FillHebYear(y, scratch);
+        return scratch;
+    }
+    if (y < HebYearTableLo || y >= HebYearTableLo + HebYearTableLen) {
+        /* Grow the table to cover this year, with some slack */
+        if (!HebYearTableLen) {
+            lo = y - 10;
+            hi = y + 11;
+        } else {
+            lo = HebYearTableLo;
+            hi = HebYearTableLo + HebYearTableLen;
+            if (y < lo) lo = y - 10;
+            if (y >= hi) hi = y + 11;
+        }
+        if (lo < HEB_FIRST_YEAR) lo = HEB_FIRST_YEAR;
+        if (hi > HEB_LAST_YEAR + 1) hi = HEB_LAST_YEAR + 1;
+        len = hi - lo;
+        table = malloc(len * sizeof(HebYearEntry));
+        if (!table) {
+            FillHebYear(y, scratch);
+            return scratch;
+        }
+        for (i=0; i<len; i++) {
+            table[i].ylen = 0;
+        }
+        for (i=0; i<HebYearTableLen; i++) {
+            table[HebYearTableLo - lo + i] = HebYearTable[i];
+        }
+        free(HebYearTable);
+        HebYearTable = table;
+        HebYearTableLo = lo;
+        HebYearTableLen = len;
+    }
+    e = &HebYearTable[y - HebYearTableLo];
+    if (!e->ylen) {
+        FillHebYear(y, e);
+    }
+    return e;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  HebToDSE                                                   */
@@ -220,6 +311,64 @@ static char const *DaysInHebMonths(int ylen)
 /*                                                             */
 /***************************************************************/
 int HebToDSE(int hy, int hm, int hd)
+{
+    HebYearEntry scratch;
+    HebYearEntry const *e;
+
+    /* Do some range checking */
+    if (hy - 3761 < BASE || hy - 3760 > BASE+YR_RANGE) return -1;
+
+    e = GetHebYear(hy, &scratch);
+    return e->rh + e->mstart[hm] + hd - 1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DSEToHeb                                                   */
+/*                                                             */
+/*  Convert a DSE to Hebrew.                                   */
+/*  Hebrew months range from 0-12, but Adar A has 0 length in  */
+/*  non-leap-years.                                            */
+/*                                                             */
+/***************************************************************/
+void DSEToHeb(int dse, int *hy, int *hm, int *hd)
+{
+    int y, m, d;
+    HebYearEntry scratch;
+    HebYearEntry const *e;
+
+    /* Rosh Hashana of y+3761 falls in the autumn of civil year y */
+    FromDSE(dse, &y, &m, &d);
+    y += 3761;
+    e = GetHebYear(y, &scratch);
+    while (e->rh > dse) {
+        e = GetHebYear(--y, &scratch);
+    }
+    while (dse >= e->rh + e->ylen) {
+        e = GetHebYear(++y, &scratch);
+    }
+
+    dse -= e->rh;
+    m = 0;
+    while((dse >= e->monlen[m]) || !e->monlen[m]) {
+        dse -= e->monlen[m];
+        m++;
+    }
+
+    *hy = y;
+    *hm = m;
+    *hd = dse+1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ArithHebToDSE                                              */
+/*                                                             */
+/*  HebToDSE by direct molad arithmetic; used to check the     */
+/*  year table.                                                */
+/*                                                             */
+/***************************************************************/
+static int ArithHebToDSE(int hy, int hm, int hd)
 {
     int ylen;
     char const *monlens;
@@ -245,14 +394,13 @@ int HebToDSE(int hy, int hm, int hd)
 
 /***************************************************************/
 /*                                                             */
-/*  DSEToHeb                                                   */
+/*  ArithDSEToHeb                                              */
 /*                                                             */
-/*  Convert a DSE to Hebrew.                                   */
-/*  Hebrew months range from 0-12, but Adar A has 0 length in  */
-/*  non-leap-years.                                            */
+/*  DSEToHeb by direct molad arithmetic; used to check the     */
+/*  year table.                                                */
 /*                                                             */
 /***************************************************************/
-void DSEToHeb(int dse, int *hy, int *hm, int *hd)
+static void ArithDSEToHeb(int dse, int *hy, int *hm, int *hd)
 {
     int y, m, d;
     int rh;
@@ -280,6 +428,62 @@ void DSEToHeb(int dse, int *hy, int *hm, int *hd)
     *hd = dse+1;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  CheckHebrewTable                                           */
+/*                                                             */
+/*  Compare the table-driven conversions against the molad     */
+/*  arithmetic for every day from 1 January y1 to 31 December  */
+/*  y2.  Prints any mismatches and returns how many there      */
+/*  were.                                                      */
+/*                                                             */
+/***************************************************************/
+int CheckHebrewTable(int y1, int y2)
+{
+    int dse, first, last;
+    int hy, hm, hd, ay, am, ad;
+    int bad = 0;
+    int ylen;
+    HebYearEntry scratch;
+    HebYearEntry const *e;
+
+    if (y1 < BASE) y1 = BASE;
+    if (y2 > BASE+YR_RANGE) y2 = BASE+YR_RANGE;
+    if (y2 < y1) return 0;
+    first = DSE(y1, 0, 1);
+    last = (y2 == BASE+YR_RANGE) ? DSE(y2, 11, 31) : DSE(y2+1, 0, 1) - 1;
+
+    for (dse = first; dse <= last; dse++) {
+        DSEToHeb(dse, &hy, &hm, &hd);
+        ArithDSEToHeb(dse, &ay, &am, &ad);
+        if (hy != ay || hm != am || hd != ad) {
+            printf("DSE %d: table gives %d-%d-%d, arithmetic %d-%d-%d\n",
+                   dse, hy, hm, hd, ay, am, ad);
+            bad++;
+            continue;
+        }
+        if (HebToDSE(hy, hm, hd) != ArithHebToDSE(hy, hm, hd)) {
+            printf("%d-%d-%d: table gives DSE %d, arithmetic %d\n",
+                   hy, hm, hd, HebToDSE(hy, hm, hd), ArithHebToDSE(hy, hm, hd));
+            bad++;
+            continue;
+        }
+        if (hm == TISHREY && hd == 1) {
+            ylen = DaysInHebYear(hy);
+            e = GetHebYear(hy, &scratch);
+            if (e->ylen != ylen ||
+                memcmp(e->monlen, DaysInHebMonths(ylen), sizeof(e->monlen))) {
+                printf("Year %d: table gives %d days, arithmetic %d\n",
+                       hy, e->ylen, ylen);
+                bad++;
+            }
+        }
+    }
+    printf("Checked %d days from %d to %d: %d mismatch%s\n",
+           last - first + 1, y1, y2, bad, bad == 1 ? "" : "es");
+    return bad;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  HebNameToNum                                               */
@@ -384,7 +588,7 @@ int GetValidHebDate(int yin, int min, int din, int adarbehave,
                            int *mout, int *dout, int jahr)
 {
     char const *monlen;
-    int ylen;
+    HebYearEntry scratch;
 
     *mout = min;
     *dout = din;
@@ -395,8 +599,7 @@ int GetValidHebDate(int yin, int min, int din, int adarbehave,
         return E_BAD_HEBDATE;
     }
 
-    ylen = DaysInHebYear(yin);
-    monlen = DaysInHebMonths(ylen);
+    monlen = GetHebYear(yin, &scratch)->monlen;
 
     /* Convert ADAR as necessary */
     if (min == ADAR) {
@@ -539,12 +742,11 @@ int GetNextHebrewDate(int dsestart, int hm, int hd,
 int ComputeJahr(int y, int m, int d, int *ans)
 {
     char const *monlen;
-    int len;
+    HebYearEntry scratch;
 
     *ans = JAHR_NONE;
 
-    len = DaysInHebYear(y);
-    monlen = DaysInHebMonths(len);
+    monlen = GetHebYear(y, &scratch)->monlen;
 
 /* Check for Adar A */
     if (m == ADARA && monlen[m] == 0) {
@@ -569,8 +771,7 @@ int ComputeJahr(int y, int m, int d, int *ans)
     }
 
 /* Get lengths of months in year following jahrzeit */
-    len = DaysInHebYear(y+1);
-    monlen = DaysInHebMonths(len);
+    monlen = GetHebYear(y+1, &scratch)->monlen;
 
     if (d > monlen[m]) *ans = JAHR_FORWARD;
     else               *ans = JAHR_BACKWARD;
@@ -231,6 +231,7 @@ void InitRemind(int argc, char const *argv[])
     PurgeFP = NULL;
 
     InitDedupeTable();
+    InitOmitFuncCache();
 
     y = NO_YR;
     m = NO_MON;
@@ -905,6 +906,7 @@ void Usage(void)
     fprintf(ErrFp, " --json                   Use JSON output instead of plain-text\n");
     fprintf(ErrFp, " --max-execution-time=n   Limit execution time to n seconds\n");
     fprintf(ErrFp, " --max-expr-complexity=n  Limit expression evaluation to n nodes per line\n");
+    fprintf(ErrFp, " --parallel-months=n      Use up to n processes for multi-month calendars\n");
     fprintf(ErrFp, " --print-config-cmd       Print ./configure cmd used to build Remind\n");
     fprintf(ErrFp, " --print-errs             Print all possible error messages\n");
     fprintf(ErrFp, " --print-tokens           Print all possible Remind tokens\n");
@@ -1237,6 +1239,29 @@ ProcessLongOption(char const *arg)
         exit(EXIT_SUCCESS);
     }
 
+    if (!strncmp(arg, "check-hebrew-table", 18)) {
+        int y1 = BASE, y2 = BASE+YR_RANGE;
+        if (arg[18] && sscanf(arg+18, "=%d,%d", &y1, &y2) != 2) {
+            fprintf(ErrFp, "%s: Usage: --check-hebrew-table[=from_year,to_year]\n", ArgV[0]);
+            exit(EXIT_FAILURE);
+        }
+        exit(CheckHebrewTable(y1, y2) ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    if (!strcmp(arg, "compile-calendar")) {
+        CompileCalendar = 1;
+        return;
+    }
+
+    if (!strncmp(arg, "cache-file=", 11)) {
+        if (!arg[11]) {
+            fprintf(ErrFp, "%s: --cache-file requires a file name\n", ArgV[0]);
+            return;
+        }
+        ScriptCacheFile = arg + 11;
+        return;
+    }
+
     if (!strcmp(arg, "hide-completed-todos")) {
         HideCompletedTodos = 1;
         return;
@@ -1262,6 +1287,14 @@ ProcessLongOption(char const *arg)
         }
         return;
     }
+    if (sscanf(arg, "parallel-months=%d", &t) == 1) {
+        if (t < 0) {
+            fprintf(ErrFp, "%s: --parallel-months must be non-negative\n", ArgV[0]);
+            return;
+        }
+        CalWorkers = t;
+        return;
+    }
     fprintf(ErrFp, "%s: Unknown long option --%s\n", ArgV[0], arg);
 }
 
@@ -48,10 +48,13 @@
 #include "err.h"
 
 static void DoReminders(void);
+static void ProcessLines(void);
 static int DoDebug(ParsePtr p);
 static void ClearLastTriggers(void);
 static int DoBanner(ParsePtr p);
 static void SaveLastTimeTrig(TimeTrig const *t);
+static void WarnAboutUnmatchedPushes(void);
+static void SaveInterpreterState(void);
 
 /* Macro for simplifying common block so as not to litter code */
 #define OUTPUT(c) do { if (output) { DBufPutc(output, c); } else { putchar(c); } } while(0)
@@ -62,7 +65,7 @@ exitfunc(void)
     /* Kill any execution-time-limiter process */
     unlimit_execution_time();
 
-    size_t num_mallocs, bytes_malloced;
+    size_t num_mallocs, bytes_malloced, arena_allocs, arena_high_water;
 
     if (DebugFlag & DB_UNUSED_VARS) {
         DumpUnusedVars();
@@ -70,9 +73,12 @@ exitfunc(void)
     if (DebugFlag & DB_HASHSTATS) {
         fflush(stdout);
         fflush(ErrFp);
-        DBufGetMallocStats(&num_mallocs, &bytes_malloced);
+        DBufGetMallocStats(&num_mallocs, &bytes_malloced,
+                           &arena_allocs, &arena_high_water);
         fprintf(ErrFp, "DynBuf Mallocs: %lu mallocs; %lu bytes\n",
                 (unsigned long) num_mallocs, (unsigned long) bytes_malloced);
+        fprintf(ErrFp, "DynBuf Arena: %lu allocations; %lu bytes high-water\n",
+                (unsigned long) arena_allocs, (unsigned long) arena_high_water);
         fprintf(ErrFp, "Variable hash table statistics:\n");
         dump_var_hash_stats();
 
@@ -85,21 +91,20 @@ exitfunc(void)
         fprintf(ErrFp, "Translation hash table statistics:\n");
         dump_translation_hash_stats();
 
+        fprintf(ErrFp, "OMITFUNC memo hash table statistics:\n");
+        dump_omitfunc_hash_stats();
+
+        DestroyOmitFuncCache();
         UnsetAllUserFuncs();
         print_expr_nodes_stats();
+        print_str_stats();
+        print_tz_stats();
+        print_shell_cache_stats();
         fprintf(ErrFp, "Max expr node evaluations per line: %lu\n", MaxExprNodesPerLine);
         fprintf(ErrFp, "Total expression node evaluations:  %lu\n", ExpressionNodesEvaluated);
     }
 }
 
-static void sigalrm(int sig)
-{
-    UNUSED(sig);
-    if (ExpressionEvaluationTimeLimit) {
-        ExpressionTimeLimitExceeded = 1;
-    }
-}
-
 static void sigxcpu(int sig)
 {
 
@@ -138,15 +143,6 @@ int main(int argc, char *argv[])
 
     InitRemind(argc, (char const **) argv);
 
-    act.sa_handler = sigalrm;
-    sigemptyset(&act.sa_mask);
-    act.sa_flags = SA_RESTART;
-    if (sigaction(SIGALRM, &act, NULL) < 0) {
-        fprintf(ErrFp, "%s: sigaction() failed: %s\n",
-                argv[0], strerror(errno));
-        exit(1);
-    }
-
     act.sa_handler = sigxcpu;
     act.sa_flags = SA_RESTART;
     sigemptyset(&act.sa_mask);
@@ -165,6 +161,7 @@ int main(int argc, char *argv[])
 
     if (IsCalendarMode()) {
         ProduceCalendar();
+        SaveDiskCache();
         return 0;
     }
 
@@ -174,8 +171,18 @@ int main(int argc, char *argv[])
         return 0;
     }
 
-    /* Not doing a calendar.  Do the regular remind loop */
-    ShouldCache = (Iterations > 1);
+    /* Not doing a calendar.  Do the regular remind loop.  A daemon
+       keeps its files cached so it can reload them in-process */
+    ShouldCache = (Iterations > 1 || ScriptCacheFile || Daemon);
+    if (Daemon) {
+        SaveInterpreterState();
+    }
+
+    /* A server-mode daemon reloads when its files change, and can
+       often get away with re-running just the files that did */
+    if (IsServerMode()) {
+        TrackDependencies();
+    }
 
     while (Iterations--) {
         if (JSONMode) {
@@ -183,6 +190,7 @@ int main(int argc, char *argv[])
         }
         PerIterationInit();
         DoReminders();
+        SaveDiskCache();
 
         if (DebugFlag & DB_DUMP_VARS) {
             DumpVarTable(0);
@@ -190,18 +198,7 @@ int main(int argc, char *argv[])
         }
 
         if (!Hush) {
-            if (DestroyOmitContexts(1)) {
-                FreshLine = 1;
-                Eprint("%s", GetErr(E_PUSH_NOPOP));
-            }
-            if (EmptyVarStack(1)) {
-                FreshLine = 1;
-                Eprint("%s", GetErr(E_PUSHV_NO_POP));
-            }
-            if (EmptyUserFuncStack(1)) {
-                FreshLine = 1;
-                Eprint("%s", GetErr(E_PUSHF_NO_POP));
-            }
+            WarnAboutUnmatchedPushes();
             if (!Daemon && !NextMode && !NumTriggered && !NumQueued) {
                 if (!JSONMode) {
                     printf("%s\n", GetErr(E_NOREMINDERS));
@@ -301,6 +298,141 @@ PerIterationInit(void)
     ClearDedupeTable();
 }
 
+/***************************************************************/
+/*                                                             */
+/*  WarnAboutUnmatchedPushes                                   */
+/*                                                             */
+/*  Complain about PUSH-OMIT-CONTEXT, PUSH-VARS and PUSH-FUNCS */
+/*  without a matching POP at the end of the script.           */
+/*                                                             */
+/***************************************************************/
+static void WarnAboutUnmatchedPushes(void)
+{
+    if (DestroyOmitContexts(1)) {
+        FreshLine = 1;
+        Eprint("%s", GetErr(E_PUSH_NOPOP));
+    }
+    if (EmptyVarStack(1)) {
+        FreshLine = 1;
+        Eprint("%s", GetErr(E_PUSHV_NO_POP));
+    }
+    if (EmptyUserFuncStack(1)) {
+        FreshLine = 1;
+        Eprint("%s", GetErr(E_PUSHF_NO_POP));
+    }
+}
+
+/* Interpreter state that the reminder script can change, as it
+   was before the script first ran.  Used by ReloadReminders. */
+static int SavedDebugFlag;
+static int SavedRunDisabled;
+static DynamicBuffer SavedBanner;
+
+/***************************************************************/
+/*                                                             */
+/*  SaveInterpreterState                                       */
+/*                                                             */
+/*  Remember what the command line left us with so the daemon  */
+/*  can reload the reminder script without re-executing.       */
+/*                                                             */
+/***************************************************************/
+static void SaveInterpreterState(void)
+{
+    SavedDebugFlag = DebugFlag;
+    SavedRunDisabled = RunDisabled;
+    DBufInit(&SavedBanner);
+    DBufPuts(&SavedBanner, DBufValue(&Banner));
+    SaveSysVars();
+    SaveCmdLineVars();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ReloadReminders                                            */
+/*                                                             */
+/*  Re-read the reminder script in-process.  This is what the  */
+/*  daemon does when the date rolls over or the reminder file  */
+/*  changes; it used to re-execute itself instead.  Files that */
+/*  have not changed stay cached and are not read again.       */
+/*                                                             */
+/***************************************************************/
+void ReloadReminders(void)
+{
+    int explicit_date = (DSEToday != RealToday);
+
+    RealToday = SystemDate(&CurYear, &CurMon, &CurDay);
+    if (explicit_date) {
+        FromDSE(DSEToday, &CurYear, &CurMon, &CurDay);
+    } else {
+        DSEToday = RealToday;
+        LocalDSEToday = DSEToday;
+    }
+
+    /* Undo whatever the script did last time */
+    DebugFlag = SavedDebugFlag;
+    RunDisabled = SavedRunDisabled;
+    DBufFree(&Banner);
+    DBufPuts(&Banner, DBufValue(&SavedBanner));
+    RestoreSysVars();
+    RestoreCmdLineVars();
+    ClearTranslationTable();
+    ClearShellCache();
+    UnsetScriptUserFuncs();
+    OnceDate = -1;
+    ProcessedOnce = 0;
+
+    if (CalculateUTC) {
+        (void) CalcMinsFromUTC(DSEToday, MinutesPastMidnight(0),
+                               &MinsFromUTC, NULL);
+    }
+
+    FlushChangedFiles();
+    PerIterationInit();
+    DoReminders();
+    SaveDiskCache();
+    if (!Hush) {
+        WarnAboutUnmatchedPushes();
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RerunChangedFiles                                          */
+/*                                                             */
+/*  Re-run just the files that changed on disk since the last  */
+/*  run, and any that depend on them, against what the last    */
+/*  run left behind.  Returns 1 if that worked, or 0 if the    */
+/*  caller must call ReloadReminders() instead.                */
+/*                                                             */
+/***************************************************************/
+int RerunChangedFiles(void)
+{
+    char const *fname;
+    int saved_rundisabled = RunDisabled;
+
+    if (PlanIncrementalReload() < 0) {
+        return 0;
+    }
+    while ((fname = BeginRerun()) != NULL) {
+        if (DebugFlag & DB_TRACE_FILES) {
+            fprintf(ErrFp, tr("Re-running `%s'"), fname);
+            fprintf(ErrFp, "\n");
+        }
+        DequeueRemindersFrom(fname);
+        UnsetUserFuncsFromFile(fname);
+        if (IncludeFile(fname)) {
+            return 0;
+        }
+        ProcessLines();
+        if (!EndRerun()) {
+            return 0;
+        }
+    }
+    RunDisabled = saved_rundisabled;
+    SaveDiskCache();
+    return 1;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  DoReminders                                                */
@@ -311,12 +443,9 @@ PerIterationInit(void)
 static void DoReminders(void)
 {
     int r;
-    Token tok;
-    char const *s;
-    Parser p;
-    int purge_handled;
 
     DidMsgReminder = 0;
+    ResetDependencies();
 
     if (!UseStdin) {
         FileAccessDate = GetAccessDate(InitialFile);
@@ -336,6 +465,24 @@ static void DoReminders(void)
                 InitialFile, GetErr(r));
         exit(EXIT_FAILURE);
     }
+    ProcessLines();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ProcessLines                                               */
+/*                                                             */
+/*  Run every line of the file opened by IncludeFile, and of   */
+/*  the files it includes.                                     */
+/*                                                             */
+/***************************************************************/
+static void ProcessLines(void)
+{
+    int r;
+    Token tok;
+    char const *s;
+    Parser p;
+    int purge_handled;
 
     while(1) {
         r = ReadLine();
@@ -662,8 +809,9 @@ int ParseChar(ParsePtr p, int *err, int peek)
         p->pos++;
         r = DoCoerce(STR_TYPE, &val);
         if (r) { *err = r; return 0; }
-        p->etext = val.v.str;
-        val.type = ERR_TYPE; /* So it's not accidentally destroyed! */
+        p->etext = strdup(val.v.str);
+        DestroyValue(val);
+        if (!p->etext) { *err = E_NO_MEM; return 0; }
         p->isnested = 1;
         p->epos = p->etext;
     }
@@ -988,6 +1136,7 @@ void Wprint(char const *fmt, ...)
     if (SuppressErrorOutputInCatch) {
         return;
     }
+    NumWarnings++;
 
     /* We can't use line_range because caller might have used it */
     if (fname) {
@@ -1385,6 +1534,8 @@ static int DoDebug(ParsePtr p)
     int ch;
     int val=1;
 
+    DepOpaque();
+
     while(1) {
         ch = ParseChar(p, &err, 0);
         if (err) return err;
@@ -1504,6 +1655,7 @@ static int DoBanner(ParsePtr p)
     int c;
     DynamicBuffer buf;
 
+    DepOpaque();
     DBufInit(&buf);
     c = ParseChar(p, &err, 0);
     if (err) return err;
@@ -1542,6 +1694,8 @@ int DoRun(ParsePtr p)
     DynamicBuffer buf;
     DBufInit(&buf);
 
+    DepOpaque();
+
     if ( (r=ParseToken(p, &buf)) ) return r;
 
 /* Only allow RUN ON in top-level script */
@@ -1574,6 +1728,8 @@ int DoExpr(ParsePtr p)
     DynamicBuffer buf;
     DBufInit(&buf);
 
+    DepOpaque();
+
     if ( (r=ParseToken(p, &buf)) ) return r;
 
 /* Only allow EXPR ON in top-level script */
@@ -1691,10 +1847,9 @@ int CalcMinsFromUTC(int dse, int tim, int *mins, int *isdst)
 /* Convert dse and tim to an Unix tm struct */
     int yr, mon, day;
     int tdiff;
-    struct tm local, utc;
-    struct tm const * temp;
-    time_t loc_t, utc_t;
-    int isdst_tmp;
+    struct tm local;
+    struct tm const * utc;
+    time_t loc_t;
 
     FromDSE(dse, &yr, &mon, &day);
 
@@ -1716,25 +1871,21 @@ int CalcMinsFromUTC(int dse, int tim, int *mins, int *isdst)
     local.tm_isdst = -1;  /* We don't know whether or not dst is in effect */
 
 
-    /* Horrible contortions to get minutes from UTC portably */
-    loc_t = mktime(&local);
-    if (loc_t == -1) return 1;
-    isdst_tmp = local.tm_isdst;
-    local.tm_isdst = 0;
-    loc_t = mktime(&local);
+    /* tz_mktime() normalizes local to the wall-clock time at loc_t,
+       so the offset is simply the difference from the UTC fields */
+    loc_t = tz_mktime(&local);
     if (loc_t == -1) return 1;
-    temp = gmtime(&loc_t);
-    utc = *temp;
-    utc.tm_isdst = 0;
-    utc_t = mktime(&utc);
-    if (utc_t == -1) return 1;
-    /* Compute difference between local time and UTC in seconds.
-       Be careful, since time_t might be unsigned. */
-
-    tdiff = (int) difftime(loc_t, utc_t);
-    if (isdst_tmp) tdiff += 60*60;
+    utc = gmtime(&loc_t);
+    if (!utc) return 1;
+    if (local.tm_year != utc->tm_year) {
+        tdiff = (local.tm_year > utc->tm_year) ? 1 : -1;
+    } else {
+        tdiff = local.tm_yday - utc->tm_yday;
+    }
+    tdiff = tdiff * 86400 + (local.tm_hour - utc->tm_hour) * 3600 +
+        (local.tm_min - utc->tm_min) * 60;
     if (mins) *mins = (int)(tdiff / 60);
-    if (isdst) *isdst = isdst_tmp;
+    if (isdst) *isdst = local.tm_isdst;
     return 0;
 }
 
@@ -2139,6 +2290,7 @@ ClearLastTriggers(void)
 void
 SaveAllTriggerInfo(Trigger const *t, TimeTrig const *tt, int trigdate, int trigtime, int valid)
 {
+    DepNoteTrigger(1);
     SaveLastTrigger(t);
     SaveLastTimeTrig(tt);
     if (trigdate != -1) {
@@ -2148,25 +2300,47 @@ SaveAllTriggerInfo(Trigger const *t, TimeTrig const *tt, int trigdate, int trigt
     LastTriggerTime = trigtime;
 }
 
-void
-SaveLastTrigger(Trigger const *t)
+/***************************************************************/
+/*                                                             */
+/*  CopyTrigger                                                */
+/*                                                             */
+/*  Make a deep copy of a trigger, including its tags, INFO    */
+/*  chain and time zone.  dest should be freed with FreeTrig.  */
+/*                                                             */
+/***************************************************************/
+int
+CopyTrigger(Trigger *dest, Trigger const *src)
 {
-    FreeTrig(&LastTrigger);
-    memcpy(&LastTrigger, t, sizeof(LastTrigger));
+    TrigInfo *cur;
+    int r;
 
-    /* DON'T hang on to the invalid info chain! */
-    LastTrigger.infos = NULL;
-    DBufInit(&(LastTrigger.tags));
+    memcpy(dest, src, sizeof(Trigger));
 
-    if (LastTrigger.tz) {
-        LastTrigger.tz = strdup(LastTrigger.tz);
+    /* DON'T hang on to the source's info chain! */
+    dest->infos = NULL;
+    DBufInit(&(dest->tags));
+
+    if (dest->tz) {
+        dest->tz = strdup(dest->tz);
+        if (!dest->tz) return E_NO_MEM;
+    }
+    if (DBufPuts(&(dest->tags), DBufValue(&(src->tags))) != OK) {
+        return E_NO_MEM;
     }
-    DBufPuts(&(LastTrigger.tags), DBufValue(&(t->tags)));
-    TrigInfo *cur = t->infos;
+    cur = src->infos;
     while(cur) {
-        AppendTrigInfo(&LastTrigger, cur->info);
+        r = AppendTrigInfo(dest, cur->info);
+        if (r) return r;
         cur = cur->next;
     }
+    return OK;
+}
+
+void
+SaveLastTrigger(Trigger const *t)
+{
+    FreeTrig(&LastTrigger);
+    (void) CopyTrigger(&LastTrigger, t);
 }
 
 static void
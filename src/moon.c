@@ -500,6 +500,65 @@ int MoonPhase(int date, int time)
     return (int) mp;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  Phase table                                                */
+/*                                                             */
+/*  truephase() results, indexed by lunation number and phase. */
+/*  Calendars call moondate() and friends for every cell, and  */
+/*  each call lands on one of a handful of lunations, so the   */
+/*  table is filled lazily and grown to cover whatever range   */
+/*  of lunations is asked for.                                 */
+/*                                                             */
+/***************************************************************/
+typedef struct {
+    double jd[4];
+    unsigned char have;  /* Bitmask of phases computed */
+} PhaseEntry;
+
+static PhaseEntry *PhaseTable = NULL;
+static int PhaseTableLo = 0;
+static int PhaseTableLen = 0;
+
+static double cached_truephase(double k, int phas)
+{
+    int lunation = (int) k;
+    int lo, hi, len, i;
+    PhaseEntry *entry, *table;
+
+    if (lunation < PhaseTableLo || lunation >= PhaseTableLo + PhaseTableLen) {
+        /* Grow the table to cover this lunation, with a year's slack */
+        if (!PhaseTableLen) {
+            lo = lunation - 12;
+            hi = lunation + 13;
+        } else {
+            lo = PhaseTableLo;
+            hi = PhaseTableLo + PhaseTableLen;
+            if (lunation < lo) lo = lunation - 12;
+            if (lunation >= hi) hi = lunation + 13;
+        }
+        len = hi - lo;
+        table = malloc(len * sizeof(PhaseEntry));
+        if (!table) return truephase(k, phas/4.0);
+        for (i=0; i<len; i++) {
+            table[i].have = 0;
+        }
+        for (i=0; i<PhaseTableLen; i++) {
+            table[PhaseTableLo - lo + i] = PhaseTable[i];
+        }
+        free(PhaseTable);
+        PhaseTable = table;
+        PhaseTableLo = lo;
+        PhaseTableLen = len;
+    }
+    entry = &PhaseTable[lunation - PhaseTableLo];
+    if (!(entry->have & (1 << phas))) {
+        entry->jd[phas] = truephase(k, phas/4.0);
+        entry->have |= (1 << phas);
+    }
+    return entry->jd[phas];
+}
+
 /***************************************************************/
 /*                                                             */
 /*  HuntPhase                                                  */
@@ -535,8 +594,8 @@ void HuntPhase(int startdate, int starttim, int phas, int *date, int *time)
         nt1 = nt2;
         k1 = k2;
     }
-    jd = truephase(k1, phas/4.0);
-    if (jd < jdorig) jd = truephase(k2, phas/4.0);
+    jd = cached_truephase(k1, phas);
+    if (jd < jdorig) jd = cached_truephase(k2, phas);
 
     /* Convert back to Remind format */
     jyear(jd, &y, &m, &d);
@@ -631,12 +690,12 @@ static time_t time_t_from_dse(int dse)
     local.tm_year = y-1900;
     local.tm_isdst = -1;
 
-    return mktime(&local);
+    return tz_mktime(&local);
 }
 
 static int datetime_from_time_t(time_t t)
 {
-    struct tm const *local;
+    struct tm local;
     int ans;
 
     /* Round to nearest minute */
@@ -647,11 +706,11 @@ static int datetime_from_time_t(time_t t)
         t -= min_offset;
     }
 
-    local = localtime(&t);
+    (void) tz_localtime_r(&t, &local);
 
-    ans = DSE(local->tm_year + 1900, local->tm_mon, local->tm_mday) * MINUTES_PER_DAY;
-    ans += local->tm_hour * 60;
-    ans += local->tm_min;
+    ans = DSE(local.tm_year + 1900, local.tm_mon, local.tm_mday) * MINUTES_PER_DAY;
+    ans += local.tm_hour * 60;
+    ans += local.tm_min;
     return ans;
 }
 
@@ -896,45 +955,113 @@ calculate_moonrise_moonset(double latitude, double longitude, time_t t,
     }
 }
 
-/* Get next moonrise or moonset in minutes after midnight of BASEYR
-   starting from given DSE.
-   Returns 0 if no moonrise could be computed
-   If want_angle is true, then returns the azimuth of the event rather
-   than the time of the event */
+/* Cache of calculate_moonrise_moonset() results, keyed by query
+   time.  The searches for consecutive days query the same instants
+   (midnight of each following day), so most lookups are hits.  Both
+   this cache and the MoonEvents cache below are dropped when the
+   location or time zone changes. */
+#define MOON_CALC_CACHE_SIZE 16
+static struct MoonInfo MoonCalcCache[MOON_CALC_CACHE_SIZE];
+static int MoonCalcCacheUsed[MOON_CALC_CACHE_SIZE];
+
+/* Rise, set and azimuths found by a search starting at one DSE */
+#define MOON_EVENT_CACHE_DAYS 64
+typedef struct {
+    int dse;            /* -1 if the slot is empty */
+    int rise, set;      /* Times of the events, or 0 if not found */
+    int rise_angle;     /* Azimuths of the events, or -1 if not found */
+    int set_angle;
+} MoonEvents;
+static MoonEvents MoonEventCache[MOON_EVENT_CACHE_DAYS];
+
+static int MoonCacheValid = 0;
+static double MoonCacheLatitude, MoonCacheLongitude;
+static unsigned int MoonCacheTzGeneration;
+
+static void moon_cache_check(void)
+{
+    int i;
 
+    if (MoonCacheValid &&
+        MoonCacheLatitude == Latitude &&
+        MoonCacheLongitude == Longitude &&
+        MoonCacheTzGeneration == TzGeneration) {
+        return;
+    }
+    for (i=0; i<MOON_CALC_CACHE_SIZE; i++) {
+        MoonCalcCacheUsed[i] = 0;
+    }
+    for (i=0; i<MOON_EVENT_CACHE_DAYS; i++) {
+        MoonEventCache[i].dse = -1;
+    }
+    MoonCacheLatitude = Latitude;
+    MoonCacheLongitude = Longitude;
+    MoonCacheTzGeneration = TzGeneration;
+    MoonCacheValid = 1;
+}
+
+static struct MoonInfo const *cached_moonrise_moonset(time_t t)
+{
+    int slot = (int) (((unsigned long) t / 86400) % MOON_CALC_CACHE_SIZE);
+    struct MoonInfo *mi = &MoonCalcCache[slot];
+
+    if (!MoonCalcCacheUsed[slot] || mi->queryTime != t) {
+        calculate_moonrise_moonset(Latitude, Longitude, t, mi);
+        MoonCalcCacheUsed[slot] = 1;
+    }
+    return mi;
+}
+
+/* Find the next moonrise and moonset on or after the start of the given
+   DSE, together with their azimuths, in a single search */
 #define ME_SEARCH_DAYS 180
-static int GetMoonevent(int dse, int is_rise, int want_angle)
+static MoonEvents const *GetMoonevents(int dse)
 {
     int i;
-    int angle;
-    struct MoonInfo mi;
-    time_t t = time_t_from_dse(dse);
-    for (i=0; i<ME_SEARCH_DAYS; i++) {
-        calculate_moonrise_moonset(Latitude, Longitude, t + i * 86400, &mi);
-        if (is_rise) {
-            if (mi.hasRise && mi.riseTime >= t) {
-                if (want_angle) {
-                    angle = (int) (mi.riseAz + 0.5);
-                    return angle;
-                } else {
-                    return datetime_from_time_t(mi.riseTime);
-                }
-            }
-        } else {
-            if (mi.hasSet && mi.setTime >= t) {
-                if (want_angle) {
-                    angle = (int) (mi.setAz + 0.5);
-                    return angle;
-                } else {
-                    return datetime_from_time_t(mi.setTime);
-                }
-            }
+    int need_rise = 1, need_set = 1;
+    struct MoonInfo const *mi;
+    MoonEvents *ev;
+    time_t t;
+
+    moon_cache_check();
+    ev = &MoonEventCache[dse % MOON_EVENT_CACHE_DAYS];
+    if (ev->dse == dse) {
+        return ev;
+    }
+
+    ev->rise = ev->set = 0;
+    ev->rise_angle = ev->set_angle = -1;
+    t = time_t_from_dse(dse);
+    for (i=0; i<ME_SEARCH_DAYS && (need_rise || need_set); i++) {
+        mi = cached_moonrise_moonset(t + i * 86400);
+        if (need_rise && mi->hasRise && mi->riseTime >= t) {
+            ev->rise = datetime_from_time_t(mi->riseTime);
+            ev->rise_angle = (int) (mi->riseAz + 0.5);
+            need_rise = 0;
+        }
+        if (need_set && mi->hasSet && mi->setTime >= t) {
+            ev->set = datetime_from_time_t(mi->setTime);
+            ev->set_angle = (int) (mi->setAz + 0.5);
+            need_set = 0;
         }
     }
-    if (want_angle) {
-        return -1;
+    ev->dse = dse;
+    return ev;
+}
+
+/* Get next moonrise or moonset in minutes after midnight of BASEYR
+   starting from given DSE.
+   Returns 0 if no moonrise could be computed
+   If want_angle is true, then returns the azimuth of the event rather
+   than the time of the event, or -1 if none could be computed */
+static int GetMoonevent(int dse, int is_rise, int want_angle)
+{
+    MoonEvents const *ev = GetMoonevents(dse);
+
+    if (is_rise) {
+        return want_angle ? ev->rise_angle : ev->rise;
     } else {
-        return 0;
+        return want_angle ? ev->set_angle : ev->set;
     }
 }
 
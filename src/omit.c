@@ -16,37 +16,106 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include "types.h"
 #include "protos.h"
 #include "globals.h"
 #include "err.h"
 
-static int BexistsIntArray (int const array[], int num, int key);
-static void InsertIntoSortedArray (int *array, int num, int key);
+/* Global full OMITs are kept in a bitmap indexed by DSE:  Day dse
+   is bit (dse % OMIT_WORD_BITS) of FullOmitBits[dse / OMIT_WORD_BITS].
+   The bitmap grows as needed, so there is no limit on the number of
+   full OMITs.  Words outside [FullOmitLo, FullOmitHi] are all zero. */
+#define OMIT_WORD_BITS 32
+#define OMIT_WORD_MASK 0xFFFFFFFFU
+static unsigned int *FullOmitBits = NULL;
+static int FullOmitWords = 0;
+static int FullOmitLo = 0;
+static int FullOmitHi = -1;
 
-/* Arrays for the global omits */
-static int FullOmitArray[MAX_FULL_OMITS];
-static int PartialOmitArray[MAX_PARTIAL_OMITS];
+/* Partial OMITs:  Day d of month m is bit d of PartialOmitBits[m] */
+static unsigned int PartialOmitBits[12];
 
 /* WeekdayOmits is declared in global.h */
 
 /* How many of each omit types do we have? */
 int NumFullOmits, NumPartialOmits;
 
+static int AddFullOmit (int dse);
+static unsigned int OmittedWord (int w, int localomit);
+
 /* The structure for saving and restoring OMIT contexts */
 typedef struct omitcontext {
     struct omitcontext *next;
     char const *filename;
     int lineno;
     int numfull, numpart;
-    int *fullsave;
-    int *partsave;
+    int fulllo, fullhi;
+    unsigned int *fullsave;
+    unsigned int partsave[12];
     int weekdaysave;
 } OmitContext;
 
 /* The stack of saved omit contexts */
 static OmitContext *SavedOmitContexts = NULL;
 
+/* Cached hash of the global OMIT context; see GlobalOmitHash() */
+static unsigned int OmitHash;
+static int OmitHashValid = 0;
+
+/* Bumped whenever the global OMIT context changes */
+static unsigned int OmitGeneration = 0;
+
+static void OmitsChanged(void)
+{
+    OmitHashValid = 0;
+    OmitGeneration++;
+}
+
+/* A prebuilt OMITFUNC call func('date').  We patch the date
+   constant and re-evaluate it rather than formatting and parsing
+   a new expression for each date */
+typedef struct omitfunc_call {
+    struct omitfunc_call *next;
+    char name[VAR_NAME_LEN+1];
+    int id;
+    expr_node node;
+    expr_node arg;
+} OmitFuncCall;
+
+static OmitFuncCall *OmitFuncCalls = NULL;
+static int NumOmitFuncCalls = 0;
+
+static OmitFuncCall *FindOmitFuncCall (char const *omitfunc);
+static int CallOmitFunc (OmitFuncCall *call, int dse, int *omit);
+
+/* Memoized results of OMITFUNC calls that evaluated as constant.
+   They remain valid until a variable or function changes */
+typedef struct omitfunc_memo {
+    struct hash_link link;
+    OmitFuncCall const *call;
+    int dse;
+    int omit;
+} OmitFuncMemo;
+
+static hash_table OmitFuncMemoTable;
+static unsigned int MemoVarGeneration;
+static unsigned int MemoFuncGeneration;
+
+static unsigned int OmitFuncMemoHashFunc(void const *x)
+{
+    OmitFuncMemo const *m = (OmitFuncMemo const *) x;
+    return (unsigned int) m->dse * 31 + (unsigned int) m->call->id;
+}
+
+static int CompareOmitFuncMemos(void const *x, void const *y)
+{
+    OmitFuncMemo const *a = (OmitFuncMemo const *) x;
+    OmitFuncMemo const *b = (OmitFuncMemo const *) y;
+    if (a->call != b->call) return a->call->id - b->call->id;
+    return a->dse - b->dse;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  ClearGlobalOmits                                           */
@@ -56,8 +125,16 @@ static OmitContext *SavedOmitContexts = NULL;
 /***************************************************************/
 int ClearGlobalOmits(void)
 {
+    if (FullOmitHi >= FullOmitLo) {
+        memset(FullOmitBits + FullOmitLo, 0,
+               (FullOmitHi - FullOmitLo + 1) * sizeof(unsigned int));
+    }
+    FullOmitLo = 0;
+    FullOmitHi = -1;
+    memset(PartialOmitBits, 0, sizeof(PartialOmitBits));
     NumFullOmits = NumPartialOmits = 0;
     WeekdayOmits = 0;
+    OmitsChanged();
     return OK;
 }
 
@@ -70,6 +147,7 @@ int ClearGlobalOmits(void)
 /***************************************************************/
 int DoClear(ParsePtr p)
 {
+    DepWrite('o', NULL);
     ClearGlobalOmits();
     return VerifyEoln(p);
 }
@@ -97,7 +175,6 @@ int DestroyOmitContexts(int print_unmatched)
         }
         num++;
         if (c->fullsave) free(c->fullsave);
-        if (c->partsave) free(c->partsave);
         d = c->next;
         free(c);
         c = d;
@@ -117,6 +194,8 @@ int PushOmitContext(ParsePtr p)
 {
     OmitContext *context;
 
+    DepPushOmits();
+
     /* Create the saved context */
     context = NEW(OmitContext);
     if (!context) return E_NO_MEM;
@@ -127,23 +206,20 @@ int PushOmitContext(ParsePtr p)
     context->numfull = NumFullOmits;
     context->numpart = NumPartialOmits;
     context->weekdaysave = WeekdayOmits;
-    context->fullsave = malloc(NumFullOmits * sizeof(int));
-    if (NumFullOmits && !context->fullsave) {
-        free(context);
-        return E_NO_MEM;
-    }
-    context->partsave = malloc(NumPartialOmits * sizeof(int));
-    if (NumPartialOmits && !context->partsave) {
-        if (context->fullsave) {
-            free(context->fullsave);
+    context->fulllo = FullOmitLo;
+    context->fullhi = FullOmitHi;
+    context->fullsave = NULL;
+    if (FullOmitHi >= FullOmitLo) {
+        context->fullsave = malloc((FullOmitHi - FullOmitLo + 1) * sizeof(unsigned int));
+        if (!context->fullsave) {
+            free(context);
+            return E_NO_MEM;
         }
-        free(context);
-        return E_NO_MEM;
+        /* Copy the context over */
+        memcpy(context->fullsave, FullOmitBits + FullOmitLo,
+               (FullOmitHi - FullOmitLo + 1) * sizeof(unsigned int));
     }
-
-    /* Copy the context over */
-    memcpy(context->fullsave, FullOmitArray, NumFullOmits * sizeof(int));
-    memcpy(context->partsave, PartialOmitArray, NumPartialOmits * sizeof(int));
+    memcpy(context->partsave, PartialOmitBits, sizeof(PartialOmitBits));
 
     /* Add the context to the stack */
     context->next = SavedOmitContexts;
@@ -165,13 +241,25 @@ int PopOmitContext(ParsePtr p)
     char const *fname = GetCurrentFilename();
 
     if (!c) return E_POP_NO_PUSH;
+    DepPopOmits();
+    /* The bitmap never shrinks, so the saved words still fit */
+    if (FullOmitHi >= FullOmitLo) {
+        memset(FullOmitBits + FullOmitLo, 0,
+               (FullOmitHi - FullOmitLo + 1) * sizeof(unsigned int));
+    }
     NumFullOmits = c->numfull;
     NumPartialOmits = c->numpart;
     WeekdayOmits = c->weekdaysave;
+    FullOmitLo = c->fulllo;
+    FullOmitHi = c->fullhi;
+    OmitsChanged();
 
     /* Copy the context over */
-    memcpy(FullOmitArray, c->fullsave, NumFullOmits * sizeof(int));
-    memcpy(PartialOmitArray, c->partsave, NumPartialOmits * sizeof(int));
+    if (c->fullsave) {
+        memcpy(FullOmitBits + FullOmitLo, c->fullsave,
+               (FullOmitHi - FullOmitLo + 1) * sizeof(unsigned int));
+    }
+    memcpy(PartialOmitBits, c->partsave, sizeof(PartialOmitBits));
 
     /* Remove the context from the stack */
     SavedOmitContexts = c->next;
@@ -182,7 +270,6 @@ int PopOmitContext(ParsePtr p)
         }
     }
     /* Free memory used by the saved context */
-    if (c->partsave) free(c->partsave);
     if (c->fullsave) free(c->fullsave);
     free(c);
 
@@ -201,6 +288,8 @@ int IsOmitted(int dse, int localomit, char const *omitfunc, int *omit)
 {
     int y, m, d;
 
+    DepRead('o', NULL);
+
     /* If we have an omitfunc, we *only* use it and ignore local/global
        OMITs */
     if (omitfunc && *omitfunc && UserFuncExists(omitfunc)) {
@@ -209,6 +298,15 @@ int IsOmitted(int dse, int localomit, char const *omitfunc, int *omit)
         int r;
         Value v;
 
+        /* Take the fast path if we can */
+        if (UserFuncExists(omitfunc) == 1 &&
+            !(DebugFlag & DB_PARSE_EXPR)) {
+            OmitFuncCall *call = FindOmitFuncCall(omitfunc);
+            if (call) {
+                return CallOmitFunc(call, dse, omit);
+            }
+        }
+
         FromDSE(dse, &y, &m, &d);
         snprintf(expr, sizeof(expr), "%s('%04d-%02d-%02d')",
                 omitfunc, y, m+1, d);
@@ -236,15 +334,20 @@ int IsOmitted(int dse, int localomit, char const *omitfunc, int *omit)
     }
 
     /* Is it omitted because of fully-specified omits? */
-    if (BexistsIntArray(FullOmitArray, NumFullOmits, dse)) {
+    if (dse >= 0 &&
+        dse / OMIT_WORD_BITS >= FullOmitLo &&
+        dse / OMIT_WORD_BITS <= FullOmitHi &&
+        (FullOmitBits[dse / OMIT_WORD_BITS] & (1U << (dse % OMIT_WORD_BITS)))) {
         *omit = 1;
         return OK;
     }
 
-    FromDSE(dse, NULL, &m, &d);
-    if (BexistsIntArray(PartialOmitArray, NumPartialOmits, (m << 5) + d)) {
-        *omit = 1;
-        return OK;
+    if (NumPartialOmits) {
+        FromDSE(dse, NULL, &m, &d);
+        if (PartialOmitBits[m] & (1U << d)) {
+            *omit = 1;
+            return OK;
+        }
     }
 
     /* Not omitted */
@@ -254,43 +357,723 @@ int IsOmitted(int dse, int localomit, char const *omitfunc, int *omit)
 
 /***************************************************************/
 /*                                                             */
-/*  BexistsIntArray                                            */
+/*  FindOmitFuncCall                                           */
+/*                                                             */
+/*  Find (or build and remember) the call omitfunc('date')     */
+/*  Returns NULL if we couldn't build it.                      */
+/*                                                             */
+/***************************************************************/
+static OmitFuncCall *
+FindOmitFuncCall(char const *omitfunc)
+{
+    OmitFuncCall *call;
+
+    for (call = OmitFuncCalls; call; call = call->next) {
+        if (!strcmp(call->name, omitfunc)) {
+            return call;
+        }
+    }
+
+    call = NEW(OmitFuncCall);
+    if (!call) {
+        return NULL;
+    }
+    memset(call, 0, sizeof(*call));
+    StrnCpy(call->name, omitfunc, VAR_NAME_LEN);
+
+    /* Build the tree the parser would have built */
+    if (strlen(call->name) < SHORT_NAME_BUF) {
+        call->node.type = N_SHORT_USER_FUNC;
+        strcpy(call->node.u.name, call->name);
+    } else {
+        call->node.type = N_USER_FUNC;
+        call->node.u.value.type = STR_TYPE;
+        call->node.u.value.v.str = call->name;
+    }
+    call->node.num_kids = 1;
+    call->node.child = &call->arg;
+    call->arg.type = N_CONSTANT;
+    call->arg.u.value.type = DATE_TYPE;
+
+    call->id = NumOmitFuncCalls++;
+    call->next = OmitFuncCalls;
+    OmitFuncCalls = call;
+    return call;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CallOmitFunc                                               */
+/*                                                             */
+/*  Evaluate an OMITFUNC call for date dse.  If the call is    */
+/*  constant, the result is memoized.                          */
+/*                                                             */
+/***************************************************************/
+static int
+CallOmitFunc(OmitFuncCall *call, int dse, int *omit)
+{
+    OmitFuncMemo *m;
+    OmitFuncMemo candidate;
+    Value v;
+    int r;
+    int nonconst = 0;
+
+    /* Throw away memoized results if anything they might
+       depend on has changed */
+    if (MemoVarGeneration != VarGeneration ||
+        MemoFuncGeneration != FuncGeneration) {
+        ClearOmitFuncMemos();
+        MemoVarGeneration = VarGeneration;
+        MemoFuncGeneration = FuncGeneration;
+    }
+
+    /* Don't use memoized results if we need to trace the call */
+    if (!(DebugFlag & DB_PRTEXPR)) {
+        candidate.call = call;
+        candidate.dse = dse;
+        m = hash_table_find(&OmitFuncMemoTable, &candidate);
+        if (m) {
+            *omit = m->omit;
+            return OK;
+        }
+    }
+
+    call->arg.u.value.v.val = dse;
+    r = evaluate_expression(&call->node, NULL, &v, &nonconst);
+    if (r) return r;
+    *omit = (v.type == INT_TYPE && v.v.val != 0);
+    DestroyValue(v);
+
+    if (!nonconst) {
+        m = NEW(OmitFuncMemo);
+        if (m) {
+            m->call = call;
+            m->dse = dse;
+            m->omit = *omit;
+            hash_table_insert(&OmitFuncMemoTable, m);
+        }
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ClearOmitFuncMemos                                         */
+/*                                                             */
+/*  Forget all memoized OMITFUNC results.                      */
+/*                                                             */
+/***************************************************************/
+void
+ClearOmitFuncMemos(void)
+{
+    OmitFuncMemo *m, *next;
+
+    m = hash_table_next(&OmitFuncMemoTable, NULL);
+    while(m) {
+        next = hash_table_next(&OmitFuncMemoTable, m);
+        hash_table_delete_no_resize(&OmitFuncMemoTable, m);
+        free(m);
+        m = next;
+    }
+    hash_table_free(&OmitFuncMemoTable);
+    InitOmitFuncCache();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DestroyOmitFuncCache                                       */
+/*                                                             */
+/*  Free the prebuilt OMITFUNC calls and memoized results.     */
+/*                                                             */
+/***************************************************************/
+void
+DestroyOmitFuncCache(void)
+{
+    OmitFuncCall *call, *next;
+
+    ClearOmitFuncMemos();
+    call = OmitFuncCalls;
+    while(call) {
+        next = call->next;
+        free(call);
+        call = next;
+    }
+    OmitFuncCalls = NULL;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  InitOmitFuncCache                                          */
+/*                                                             */
+/*  Initialize the OMITFUNC memo table at program startup      */
+/*                                                             */
+/***************************************************************/
+void
+InitOmitFuncCache(void)
+{
+    if (hash_table_init(&OmitFuncMemoTable,
+                        offsetof(OmitFuncMemo, link),
+                        OmitFuncMemoHashFunc, CompareOmitFuncMemos) < 0) {
+        fprintf(ErrFp, "Unable to initialize OMITFUNC hash table: Out of memory.  Exiting.\n");
+        exit(1);
+    }
+}
+
+void
+dump_omitfunc_hash_stats(void)
+{
+    hash_table_dump_stats(&OmitFuncMemoTable, ErrFp);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  AddFullOmit                                                */
+/*                                                             */
+/*  Set the bit for dse in the full OMIT bitmap, growing the   */
+/*  bitmap if necessary.                                       */
+/*                                                             */
+/***************************************************************/
+static int AddFullOmit(int dse)
+{
+    int w = dse / OMIT_WORD_BITS;
+    unsigned int bit = 1U << (dse % OMIT_WORD_BITS);
+
+    if (w >= FullOmitWords) {
+        int n = FullOmitWords ? FullOmitWords : 512;
+        unsigned int *bits;
+        while (n <= w) n *= 2;
+        bits = realloc(FullOmitBits, n * sizeof(unsigned int));
+        if (!bits) return E_NO_MEM;
+        memset(bits + FullOmitWords, 0,
+               (n - FullOmitWords) * sizeof(unsigned int));
+        FullOmitBits = bits;
+        FullOmitWords = n;
+    }
+    if (FullOmitHi < FullOmitLo) {
+        FullOmitLo = FullOmitHi = w;
+    } else if (w < FullOmitLo) {
+        FullOmitLo = w;
+    } else if (w > FullOmitHi) {
+        FullOmitHi = w;
+    }
+    if (!(FullOmitBits[w] & bit)) {
+        FullOmitBits[w] |= bit;
+        NumFullOmits++;
+        OmitsChanged();
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Bit-twiddling helpers for 32-bit words of days             */
+/*                                                             */
+/***************************************************************/
+static int LowestBit(unsigned int x)
+{
+    int n = 0;
+    if (!(x & 0xFFFF)) { n += 16; x >>= 16; }
+    if (!(x & 0xFF))   { n += 8;  x >>= 8;  }
+    if (!(x & 0xF))    { n += 4;  x >>= 4;  }
+    if (!(x & 0x3))    { n += 2;  x >>= 2;  }
+    if (!(x & 0x1))    { n += 1; }
+    return n;
+}
+
+static int HighestBit(unsigned int x)
+{
+    int n = 0;
+    if (x & 0xFFFF0000) { n += 16; x >>= 16; }
+    if (x & 0xFF00)     { n += 8;  x >>= 8;  }
+    if (x & 0xF0)       { n += 4;  x >>= 4;  }
+    if (x & 0xC)        { n += 2;  x >>= 2;  }
+    if (x & 0x2)        { n += 1; }
+    return n;
+}
+
+static int CountBits(unsigned int x)
+{
+    x = x - ((x >> 1) & 0x55555555U);
+    x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+    x = (x + (x >> 4)) & 0x0F0F0F0FU;
+    return (int) ((x * 0x01010101U) >> 24) & 0xFF;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  OmittedWord                                                */
 /*                                                             */
-/*  Perform a binary search on an integer array.  Return 1 if  */
-/*  element is found, 0 otherwise.                             */
+/*  Return a mask of the days in word w of the bitmap (that    */
+/*  is, days w*32 through w*32+31) that are omitted by the     */
+/*  weekdays in localomit or by the global OMIT context.       */
+/*  Bit i is set if day w*32+i is omitted.                     */
 /*                                                             */
 /***************************************************************/
-static int BexistsIntArray(int const array[], int num, int key)
+static unsigned int OmittedWord(int w, int localomit)
 {
-    int top=num-1, bot=0, mid;
+    /* Weekday masks for words starting on each day of the week */
+    static unsigned int WeekdayWords[7];
+    static int WeekdayWordsFor = 0;
+
+    int first = w * OMIT_WORD_BITS;
+    int wd = WeekdayOmits | localomit;
+    unsigned int mask = 0;
+    int i, y, m, d;
+
+    if (w >= FullOmitLo && w <= FullOmitHi) {
+        mask = FullOmitBits[w];
+    }
 
-    while (top >= bot) {
-        mid = (top+bot)/2;
-        if (array[mid] == key) return 1;
-        else if (array[mid] > key) top = mid-1;
-        else bot=mid+1;
+    if (wd) {
+        if (wd != WeekdayWordsFor) {
+            int j;
+            for (j=0; j<7; j++) {
+                WeekdayWords[j] = 0;
+                for (i=0; i<OMIT_WORD_BITS; i++) {
+                    if (wd & (1 << ((j+i) % 7))) {
+                        WeekdayWords[j] |= 1U << i;
+                    }
+                }
+            }
+            WeekdayWordsFor = wd;
+        }
+        mask |= WeekdayWords[first % 7];
+    }
+
+    if (NumPartialOmits) {
+        FromDSE(first, &y, &m, &d);
+        for (i=0; i<OMIT_WORD_BITS; i++) {
+            if (PartialOmitBits[m] & (1U << d)) {
+                mask |= 1U << i;
+            }
+            if (++d > DaysInMonth(m, y)) {
+                d = 1;
+                if (++m > 11) {
+                    m = 0;
+                    y++;
+                }
+            }
+        }
+    }
+    return mask;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  NextNonOmitted                                             */
+/*                                                             */
+/*  Return the first day at or after (dir > 0) or at or        */
+/*  before (dir < 0) dse that is not omitted by localomit or   */
+/*  the global OMIT context, looking at no more than maxdays   */
+/*  days.  Return -1 if there is no such day.  OMITFUNCs are   */
+/*  not considered; callers must handle them with IsOmitted.   */
+/*                                                             */
+/***************************************************************/
+int NextNonOmitted(int dse, int dir, int localomit, int maxdays)
+{
+    int w, lim, d;
+    unsigned int avail;
+
+    DepRead('o', NULL);
+    if (dse < 0 || maxdays <= 0) return -1;
+    if (dir > 0) {
+        lim = (maxdays > INT_MAX - dse) ? INT_MAX : dse + maxdays - 1;
+        while (dse <= lim) {
+            w = dse / OMIT_WORD_BITS;
+            avail = ~OmittedWord(w, localomit) &
+                (OMIT_WORD_MASK << (dse % OMIT_WORD_BITS));
+            avail &= OMIT_WORD_MASK;
+            if (avail) {
+                d = w * OMIT_WORD_BITS + LowestBit(avail);
+                return (d <= lim) ? d : -1;
+            }
+            if (w >= INT_MAX / OMIT_WORD_BITS - 1) break;
+            dse = (w + 1) * OMIT_WORD_BITS;
+        }
+    } else {
+        lim = dse - maxdays + 1;
+        if (lim < 0) lim = 0;
+        while (dse >= lim) {
+            w = dse / OMIT_WORD_BITS;
+            avail = ~OmittedWord(w, localomit) &
+                (OMIT_WORD_MASK >> (OMIT_WORD_BITS - 1 - dse % OMIT_WORD_BITS));
+            if (avail) {
+                d = w * OMIT_WORD_BITS + HighestBit(avail);
+                return (d >= lim) ? d : -1;
+            }
+            dse = w * OMIT_WORD_BITS - 1;
+        }
+    }
+    return -1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SlideNonOmittedScan                                        */
+/*                                                             */
+/*  SlideNonOmitted by scanning the bitmaps a word at a time.  */
+/*                                                             */
+/***************************************************************/
+static int SlideNonOmittedScan(int dse, int amt, int localomit, int maxdays)
+{
+    int w, c, lim;
+    unsigned int avail;
+
+    if (dse < 0) return -1;
+    if (!amt) return dse;
+    if (amt > 0) {
+        lim = (maxdays > INT_MAX - dse) ? INT_MAX : dse + maxdays;
+        dse++;
+        while (dse <= lim) {
+            w = dse / OMIT_WORD_BITS;
+            avail = ~OmittedWord(w, localomit) &
+                (OMIT_WORD_MASK << (dse % OMIT_WORD_BITS));
+            avail &= OMIT_WORD_MASK;
+            c = CountBits(avail);
+            if (c >= amt) {
+                while (--amt) {
+                    avail &= avail - 1;
+                }
+                dse = w * OMIT_WORD_BITS + LowestBit(avail);
+                return (dse <= lim) ? dse : -1;
+            }
+            amt -= c;
+            if (w >= INT_MAX / OMIT_WORD_BITS - 1) break;
+            dse = (w + 1) * OMIT_WORD_BITS;
+        }
+    } else {
+        amt = -amt;
+        lim = dse - maxdays;
+        if (lim < 0) lim = 0;
+        dse--;
+        while (dse >= lim) {
+            w = dse / OMIT_WORD_BITS;
+            avail = ~OmittedWord(w, localomit) &
+                (OMIT_WORD_MASK >> (OMIT_WORD_BITS - 1 - dse % OMIT_WORD_BITS));
+            c = CountBits(avail);
+            if (c >= amt) {
+                while (--amt) {
+                    avail &= ~(1U << HighestBit(avail));
+                }
+                dse = w * OMIT_WORD_BITS + HighestBit(avail);
+                return (dse >= lim) ? dse : -1;
+            }
+            amt -= c;
+            dse = w * OMIT_WORD_BITS - 1;
+        }
+    }
+    return -1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CountNonOmittedScan                                        */
+/*                                                             */
+/*  CountNonOmitted by scanning the bitmaps a word at a time.  */
+/*                                                             */
+/***************************************************************/
+static int CountNonOmittedScan(int from, int to, int localomit)
+{
+    int w, n = 0;
+    unsigned int avail;
+
+    while (from < to) {
+        w = from / OMIT_WORD_BITS;
+        avail = ~OmittedWord(w, localomit) &
+            (OMIT_WORD_MASK << (from % OMIT_WORD_BITS));
+        avail &= OMIT_WORD_MASK;
+        if (to - w * OMIT_WORD_BITS < OMIT_WORD_BITS) {
+            avail &= OMIT_WORD_MASK >> (OMIT_WORD_BITS - (to - w * OMIT_WORD_BITS));
+        }
+        n += CountBits(avail);
+        from = (w + 1) * OMIT_WORD_BITS;
+    }
+    return n;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Rank indexes                                               */
+/*                                                             */
+/*  For a given set of omitted weekdays, a rank index holds    */
+/*  the non-omitted days of each word over a range of words,   */
+/*  and a running count of them.  Counting the non-omitted     */
+/*  days between two dates is then a subtraction, and moving   */
+/*  N non-omitted days is a binary search, however far apart   */
+/*  the dates are.                                             */
+/*                                                             */
+/*  An index remembers the OMIT context it was built from.     */
+/*  Since the calendar rebuilds the same context for every     */
+/*  day, we compare contents rather than just trusting         */
+/*  OmitGeneration before throwing an index away.              */
+/*                                                             */
+/***************************************************************/
+#define NUM_RANK_INDEXES 4
+#define RANK_SLACK_WORDS 12
+
+typedef struct {
+    int wd;                 /* WeekdayOmits | localomit */
+    int lo, hi;             /* Words covered: [lo, hi); empty if lo == hi */
+    unsigned int gen;       /* OmitGeneration when last known current */
+    unsigned int partial[12];
+    unsigned int *full;     /* Full OMIT words lo..hi-1 when built */
+    unsigned int *avail;    /* Non-omitted days in words lo..hi-1 */
+    int *rank;              /* rank[i] = non-omitted days in words lo..lo+i-1 */
+    unsigned long lastuse;
+} RankIndex;
+
+static RankIndex RankIndexes[NUM_RANK_INDEXES];
+static unsigned long RankIndexUses = 0;
+static int RankMaxWord = 0;
+
+static unsigned int FullWord(int w)
+{
+    if (w >= FullOmitLo && w <= FullOmitHi) {
+        return FullOmitBits[w];
     }
     return 0;
 }
 
+static int RankIndexCurrent(RankIndex *ix)
+{
+    int w;
+
+    if (ix->gen == OmitGeneration) return 1;
+    if (memcmp(ix->partial, PartialOmitBits, sizeof(PartialOmitBits))) return 0;
+    for (w=ix->lo; w<ix->hi; w++) {
+        if (ix->full[w - ix->lo] != FullWord(w)) return 0;
+    }
+    ix->gen = OmitGeneration;
+    return 1;
+}
+
+/* (Re)build ix to cover words [lo, hi), reusing the words it already
+   has if keep is true */
+static int FillRankIndex(RankIndex *ix, int lo, int hi, int keep)
+{
+    int len = hi - lo;
+    int i, w;
+    unsigned int *full, *avail;
+    int *rank;
+
+    full = malloc(len * sizeof(unsigned int));
+    avail = malloc(len * sizeof(unsigned int));
+    rank = malloc((len + 1) * sizeof(int));
+    if (!full || !avail || !rank) {
+        free(full);
+        free(avail);
+        free(rank);
+        return E_NO_MEM;
+    }
+    rank[0] = 0;
+    for (i=0; i<len; i++) {
+        w = lo + i;
+        if (keep && w >= ix->lo && w < ix->hi) {
+            full[i] = ix->full[w - ix->lo];
+            avail[i] = ix->avail[w - ix->lo];
+        } else {
+            full[i] = FullWord(w);
+            avail[i] = ~OmittedWord(w, ix->wd) & OMIT_WORD_MASK;
+        }
+        rank[i+1] = rank[i] + CountBits(avail[i]);
+    }
+    free(ix->full);
+    free(ix->avail);
+    free(ix->rank);
+    ix->full = full;
+    ix->avail = avail;
+    ix->rank = rank;
+    ix->lo = lo;
+    ix->hi = hi;
+    ix->gen = OmitGeneration;
+    memcpy(ix->partial, PartialOmitBits, sizeof(PartialOmitBits));
+    return OK;
+}
+
 /***************************************************************/
 /*                                                             */
-/*  InsertIntoSortedArray                                      */
+/*  GetRankIndex                                               */
 /*                                                             */
-/*  Insert a key into a sorted array.  We assume that there is */
-/*  room in the array for it.                                  */
+/*  Return a current rank index for localomit covering at      */
+/*  least words [wlo, whi), or NULL if we can't have one       */
+/*  (the range is outside Remind's dates, or we're out of      */
+/*  memory.)                                                   */
 /*                                                             */
 /***************************************************************/
-static void InsertIntoSortedArray(int *array, int num, int key)
+static RankIndex *GetRankIndex(int localomit, int wlo, int whi)
 {
-    /* num is number of elements CURRENTLY in the array. */
-    int *cur = array+num;
+    int wd = (WeekdayOmits | localomit) & 0x7F;
+    int i, lo, hi;
+    RankIndex *ix = NULL;
 
-    while (cur > array && *(cur-1) > key) {
-        *cur = *(cur-1);
-        cur--;
+    if (!RankMaxWord) {
+        RankMaxWord = DSE(BASE+YR_RANGE, 11, 31) / OMIT_WORD_BITS + 1;
     }
-    *cur = key;
+    if (wlo < 0 || whi > RankMaxWord || wlo >= whi) return NULL;
+
+    for (i=0; i<NUM_RANK_INDEXES; i++) {
+        if (RankIndexes[i].hi > RankIndexes[i].lo && RankIndexes[i].wd == wd) {
+            ix = &RankIndexes[i];
+            break;
+        }
+    }
+
+    if (ix && RankIndexCurrent(ix)) {
+        if (wlo < ix->lo || whi > ix->hi) {
+            /* Extend, at least doubling so repeated growth is cheap */
+            lo = ix->lo;
+            hi = ix->hi;
+            if (wlo < lo) lo = wlo - (hi - lo);
+            if (whi > hi) hi = whi + (hi - lo);
+            if (lo < 0) lo = 0;
+            if (hi > RankMaxWord) hi = RankMaxWord;
+            if (FillRankIndex(ix, lo, hi, 1) != OK) return NULL;
+        }
+    } else {
+        if (!ix) {
+            /* Take an unused slot, or the least-recently used one */
+            ix = &RankIndexes[0];
+            for (i=1; i<NUM_RANK_INDEXES; i++) {
+                if (RankIndexes[i].lastuse < ix->lastuse) {
+                    ix = &RankIndexes[i];
+                }
+            }
+            ix->wd = wd;
+        }
+        lo = wlo - RANK_SLACK_WORDS;
+        hi = whi + RANK_SLACK_WORDS;
+        if (lo < 0) lo = 0;
+        if (hi > RankMaxWord) hi = RankMaxWord;
+        if (FillRankIndex(ix, lo, hi, 0) != OK) {
+            ix->lo = ix->hi = 0;
+            return NULL;
+        }
+    }
+    ix->lastuse = ++RankIndexUses;
+    return ix;
+}
+
+/* Number of non-omitted days from the start of the index up to, but
+   not including, day dse */
+static int RankOf(RankIndex const *ix, int dse)
+{
+    int i = dse / OMIT_WORD_BITS - ix->lo;
+    int b = dse % OMIT_WORD_BITS;
+
+    if (i >= ix->hi - ix->lo) return ix->rank[ix->hi - ix->lo];
+    if (!b) return ix->rank[i];
+    return ix->rank[i] + CountBits(ix->avail[i] & (OMIT_WORD_MASK >> (OMIT_WORD_BITS - b)));
+}
+
+/* The day of the t'th (1-based) non-omitted day in the index */
+static int RankSelect(RankIndex const *ix, int t)
+{
+    int lo = 0, hi = ix->hi - ix->lo - 1, mid;
+    unsigned int avail;
+
+    /* Find the last word with fewer than t days before it */
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (ix->rank[mid] < t) lo = mid;
+        else hi = mid - 1;
+    }
+    avail = ix->avail[lo];
+    t -= ix->rank[lo];
+    while (--t) {
+        avail &= avail - 1;
+    }
+    return (ix->lo + lo) * OMIT_WORD_BITS + LowestBit(avail);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SlideNonOmitted                                            */
+/*                                                             */
+/*  Starting from dse, move forward (amt > 0) or backward      */
+/*  (amt < 0) by abs(amt) days that are not omitted by         */
+/*  localomit or the global OMIT context, but by no more than  */
+/*  maxdays days in total.  Return the day we land on, or -1   */
+/*  if we run out of days.                                     */
+/*                                                             */
+/***************************************************************/
+int SlideNonOmitted(int dse, int amt, int localomit, int maxdays)
+{
+    RankIndex *ix;
+    int lim, wlo, whi, t, d, perweek;
+
+    DepRead('o', NULL);
+    if (dse < 0) return -1;
+    if (!amt) return dse;
+
+    perweek = 7 - CountBits((WeekdayOmits | localomit) & 0x7F);
+    if (!perweek) {
+        return SlideNonOmittedScan(dse, amt, localomit, maxdays);
+    }
+    if (amt > 0) {
+        lim = (maxdays > INT_MAX - dse) ? INT_MAX : dse + maxdays;
+        /* Guess how far we need to go from the weekday OMITs */
+        wlo = (dse + 1) / OMIT_WORD_BITS;
+        whi = (amt > INT_MAX / 8) ? INT_MAX : (dse + 1 + amt / perweek * 7 + 7) / OMIT_WORD_BITS + 2;
+        while (1) {
+            if (whi > lim / OMIT_WORD_BITS + 1) whi = lim / OMIT_WORD_BITS + 1;
+            if (whi > RankMaxWord && RankMaxWord) whi = RankMaxWord;
+            ix = GetRankIndex(localomit, wlo, whi);
+            if (!ix) break;
+            t = RankOf(ix, dse + 1) + amt;
+            if (t <= ix->rank[ix->hi - ix->lo]) {
+                d = RankSelect(ix, t);
+                return (d <= lim) ? d : -1;
+            }
+            if ((long) ix->hi * OMIT_WORD_BITS > lim) return -1;
+            if (ix->hi >= RankMaxWord) break;
+            wlo = ix->lo;
+            whi = ix->hi + 1;
+        }
+    } else {
+        lim = dse - maxdays;
+        if (lim < 0) lim = 0;
+        wlo = (dse > (long) -amt / perweek * 7 + 7) ? (dse + amt / perweek * 7 - 7) / OMIT_WORD_BITS - 1 : 0;
+        whi = dse / OMIT_WORD_BITS + 1;
+        while (1) {
+            if (wlo < lim / OMIT_WORD_BITS) wlo = lim / OMIT_WORD_BITS;
+            if (wlo < 0) wlo = 0;
+            ix = GetRankIndex(localomit, wlo, whi);
+            if (!ix) break;
+            t = RankOf(ix, dse) + amt + 1;
+            if (t >= 1) {
+                d = RankSelect(ix, t);
+                return (d >= lim) ? d : -1;
+            }
+            if (ix->lo * OMIT_WORD_BITS <= lim) return -1;
+            wlo = ix->lo - 1;
+            whi = ix->hi;
+        }
+    }
+    return SlideNonOmittedScan(dse, amt, localomit, maxdays);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CountNonOmitted                                            */
+/*                                                             */
+/*  Return the number of days from `from' up to but not        */
+/*  including `to' that are not omitted by localomit or the    */
+/*  global OMIT context.                                       */
+/*                                                             */
+/***************************************************************/
+int CountNonOmitted(int from, int to, int localomit)
+{
+    RankIndex *ix;
+
+    DepRead('o', NULL);
+    if (from < 0) from = 0;
+    if (from >= to) return 0;
+    ix = GetRankIndex(localomit, from / OMIT_WORD_BITS,
+                      (to - 1) / OMIT_WORD_BITS + 1);
+    if (!ix) {
+        return CountNonOmittedScan(from, to, localomit);
+    }
+    return RankOf(ix, to) - RankOf(ix, from);
 }
 
 static void DumpOmits(void);
@@ -308,7 +1091,6 @@ int DoOmit(ParsePtr p)
     Token tok;
     int parsing = 1;
     int seen_through = 0;
-    int syndrome;
     int not_first_token = -1;
     int start, end, tmp;
     int wd = 0;
@@ -318,6 +1100,8 @@ int DoOmit(ParsePtr p)
     DynamicBuffer buf;
     DBufInit(&buf);
 
+    DepWrite('o', NULL);
+
 /* Parse the OMIT.  We need a month and day; year is optional. */
     while(parsing) {
         not_first_token++;
@@ -408,6 +1192,7 @@ int DoOmit(ParsePtr p)
             return E_2MANY_LOCALOMIT;
         }
         WeekdayOmits |= wd;
+        OmitsChanged();
         if (tok.type == T_Tag || tok.type == T_Info || tok.type == T_Duration || tok.type == T_RemType || tok.type == T_Priority) return E_PARSE_AS_REM;
         return OK;
     }
@@ -453,10 +1238,10 @@ int DoOmit(ParsePtr p)
         dc = d[0];
         mc = m[0];
         while(1) {
-            syndrome = (mc<<5) + dc;
-            if (!BexistsIntArray(PartialOmitArray, NumPartialOmits, syndrome)) {
-                InsertIntoSortedArray(PartialOmitArray, NumPartialOmits, syndrome);
+            if (!(PartialOmitBits[mc] & (1U << dc))) {
+                PartialOmitBits[mc] |= 1U << dc;
                 NumPartialOmits++;
+                OmitsChanged();
                 if (NumPartialOmits == 366) {
                     if (warning_level("04.02.09")) {
                         Wprint(tr("You have OMITted everything!  The space-time continuum is at risk."));
@@ -487,11 +1272,8 @@ int DoOmit(ParsePtr p)
         }
 
         for (tmp = start; tmp <= end; tmp++) {
-            if (!BexistsIntArray(FullOmitArray, NumFullOmits, tmp)) {
-                if (NumFullOmits >= MAX_FULL_OMITS) return E_2MANY_FULL;
-                InsertIntoSortedArray(FullOmitArray, NumFullOmits, tmp);
-                NumFullOmits++;
-            }
+            r = AddFullOmit(tmp);
+            if (r) return r;
         }
     }
 
@@ -506,12 +1288,53 @@ AddGlobalOmit(int dse)
     if (dse < 0) {
         return OK;
     }
-    if (NumFullOmits == MAX_FULL_OMITS) return E_2MANY_FULL;
-    if (!BexistsIntArray(FullOmitArray, NumFullOmits, dse)) {
-        InsertIntoSortedArray(FullOmitArray, NumFullOmits, dse);
-        NumFullOmits++;
+    DepWrite('o', NULL);
+    return AddFullOmit(dse);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  GlobalOmitHash                                             */
+/*                                                             */
+/*  Return a hash of the global OMIT context, so callers can   */
+/*  tell cheaply whether it has changed since they last        */
+/*  looked.  The hash is recomputed only after a change.       */
+/*                                                             */
+/***************************************************************/
+static unsigned int HashInt(unsigned int h, int x)
+{
+    /* FNV-1a, one int at a time */
+    h ^= (unsigned int) x;
+    h *= 16777619U;
+    return h;
+}
+
+unsigned int
+GlobalOmitHash(void)
+{
+    int i;
+    unsigned int h;
+
+    DepRead('o', NULL);
+    if (OmitHashValid) {
+        return OmitHash;
     }
-    return OK;
+    h = 2166136261U;
+    h = HashInt(h, WeekdayOmits);
+    h = HashInt(h, NumFullOmits);
+    for (i=FullOmitLo; i<=FullOmitHi; i++) {
+        if (FullOmitBits[i]) {
+            h = HashInt(h, i);
+            h = HashInt(h, (int) FullOmitBits[i]);
+        }
+    }
+    h = HashInt(h, NumPartialOmits);
+    for (i=0; i<12; i++) {
+        h = HashInt(h, (int) PartialOmitBits[i]);
+    }
+    OmitHash = h;
+    OmitHashValid = 1;
+    return h;
 }
 
 void
@@ -527,24 +1350,28 @@ DumpOmits(void)
     if (PurgeMode) {
         return;
     }
-    printf("Global Full OMITs (%d of maximum allowed %d):\n", NumFullOmits, MAX_FULL_OMITS);
+    printf("Global Full OMITs (%d):\n", NumFullOmits);
     if (!NumFullOmits) {
         printf("\tNone.\n");
     } else {
-        for (i=0; i<NumFullOmits; i++) {
-            FromDSE(FullOmitArray[i], &y, &m, &d);
-            printf("\t%04d%c%02d%c%02d\n",
-                    y, DateSep, m+1, DateSep, d);
+        for (i=FullOmitLo*OMIT_WORD_BITS; i<(FullOmitHi+1)*OMIT_WORD_BITS; i++) {
+            if (FullOmitBits[i / OMIT_WORD_BITS] & (1U << (i % OMIT_WORD_BITS))) {
+                FromDSE(i, &y, &m, &d);
+                printf("\t%04d%c%02d%c%02d\n",
+                       y, DateSep, m+1, DateSep, d);
+            }
         }
     }
     printf("Global Partial OMITs (%d of maximum allowed %d):\n", NumPartialOmits, MAX_PARTIAL_OMITS);
     if (!NumPartialOmits) {
         printf("\tNone.\n");
     } else {
-        for (i=0; i<NumPartialOmits; i++) {
-            m = PartialOmitArray[i] >> 5 & 0xf;
-            d = PartialOmitArray[i] & 0x1f;
-            printf("\t%02d%c%02d\n", m+1, DateSep, d);
+        for (m=0; m<12; m++) {
+            for (d=1; d<=31; d++) {
+                if (PartialOmitBits[m] & (1U << d)) {
+                    printf("\t%02d%c%02d\n", m+1, DateSep, d);
+                }
+            }
         }
     }
     printf("Global Weekday OMITs:\n");
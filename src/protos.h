@@ -29,18 +29,24 @@
 
 #include "dynbuf.h"
 #include <ctype.h>
+#include <time.h>  /* For time_t used by the tz_ functions */
 
 int CallUserFunc (char const *name, int nargs, ParsePtr p);
 int DoFset (ParsePtr p);
 int DoFunset (ParsePtr p);
 int DoFrename (ParsePtr p);
 void UnsetAllUserFuncs(void);
+void UnsetScriptUserFuncs(void);
+void UnsetUserFuncsFromFile(char const *fname);
 void ProduceCalendar (void);
 char const *SimpleTime (int tim);
 int DoRem (ParsePtr p);
 int DoFlush (ParsePtr p);
 void DoExit (ParsePtr p);
 int ParseRem (ParsePtr s, Trigger *trig, TimeTrig *tim);
+int ParseRemCompiled (ParsePtr s, Trigger *trig, TimeTrig *tim);
+void FreeCompiledRem(CompiledRem *c);
+CompiledRem **CurrentCompiledRem(void);
 int TriggerReminder (ParsePtr p, Trigger *t, TimeTrig const *tim, int dse, int is_queued, DynamicBuffer *output, int *r, int *g, int *b);
 int ShouldTriggerReminder (Trigger const *t, TimeTrig const *tim, int dse, int *err);
 int DoSubst (ParsePtr p, DynamicBuffer *dbuf, Trigger *t, TimeTrig const *tt, int dse, int mode);
@@ -60,6 +66,11 @@ int EvalExprRunDisabled(char const **e, Value *v, ParsePtr p);
 int DoCoerce (char type, Value *v);
 char const *PrintValue  (Value const *v, FILE *fp);
 int CopyValue (Value *dest, const Value *src);
+char *AllocStr(size_t len);
+char *DupStr(char const *s);
+void ReleaseStr(char *s);
+int MakeStrUnique(Value *v);
+void print_str_stats(void);
 int ReadLine (void);
 int DoInclude (ParsePtr p, enum TokTypes tok);
 int DoIncludeCmd (ParsePtr p);
@@ -67,6 +78,20 @@ int IncludeFile (char const *fname);
 int GetAccessDate (char const *file);
 int SetAccessDate (char const *fname, int dse);
 int TopLevel (void);
+void SaveDiskCache (void);
+void FlushChangedFiles (void);
+void TrackDependencies (void);
+void ResetDependencies (void);
+void DepRead (int kind, char const *name);
+void DepWrite (int kind, char const *name);
+void DepPushOmits (void);
+void DepPopOmits (void);
+void DepNoteTrigger (int set);
+void DepNoteBuiltin (char const *name);
+void DepOpaque (void);
+int PlanIncrementalReload (void);
+char const *BeginRerun (void);
+int EndRerun (void);
 int CallFunc (BuiltinFunc *f, int nargs);
 void InitRemind (int argc, char const *argv[]);
 void Usage (void);
@@ -110,14 +135,26 @@ int DestroyOmitContexts (int print_unmatched);
 int PushOmitContext (ParsePtr p);
 int PopOmitContext (ParsePtr p);
 int IsOmitted (int dse, int localomit, char const *omitfunc, int *omit);
+int NextNonOmitted (int dse, int dir, int localomit, int maxdays);
+int SlideNonOmitted (int dse, int amt, int localomit, int maxdays);
+int CountNonOmitted (int from, int to, int localomit);
 int DoOmit (ParsePtr p);
+unsigned int GlobalOmitHash (void);
+void InitOmitFuncCache (void);
+void ClearOmitFuncMemos (void);
+void DestroyOmitFuncCache (void);
+void dump_omitfunc_hash_stats(void);
 int QueueReminder (ParsePtr p, Trigger *trig, TimeTrig const *tim, char const *sched, int dse);
+void DequeueRemindersFrom (char const *fname);
 void HandleQueuedReminders (void);
 char const *FindInitialToken (Token *tok, char const *s);
 void FindToken (char const *s, Token *tok);
 int ComputeTrigger (int today, Trigger *trig, TimeTrig *tim, int *err, int save_in_globals);
 int ComputeTriggerNoAdjustDuration (int today, Trigger *trig, TimeTrig const *tim, int *err, int save_in_globals, int duration_days);
 int AdjustTriggerForDuration(int today, int r, Trigger *trig, TimeTrig *tim, int save_in_globals);
+int ComputeTriggerDates (int from, int to, Trigger *trig, TimeTrig const *tim, TriggerDates *td);
+int ComputeTriggerFromDates (int today, int to, Trigger *trig, TimeTrig *tim, TriggerDates *td, int *err);
+void FreeTriggerDates (TriggerDates *td);
 char *StrnCpy (char *dest, char const *source, int n);
 
 void strtolower(char *s);
@@ -137,6 +174,10 @@ int PopUserFuncs(ParsePtr p);
 void DumpVarTable (int dump_constness);
 void DumpUnusedVars(void);
 void DestroyVars (int all);
+void SaveSysVars (void);
+void RestoreSysVars (void);
+void SaveCmdLineVars (void);
+void RestoreCmdLineVars (void);
 int PreserveVar (char const *name);
 int DoPreserve  (Parser *p);
 int DoSatRemind (Trigger *trig, TimeTrig *tt, ParsePtr p);
@@ -157,6 +198,7 @@ int HebToDSE (int hy, int hm, int hd);
 int GetValidHebDate (int yin, int min, int din, int adarbehave, int *mout, int *dout, int yahr);
 int GetNextHebrewDate (int dsestart, int hm, int hd, int yahr, int adarbehave, int *ans);
 int ComputeJahr (int y, int m, int d, int *ans);
+int CheckHebrewTable (int y1, int y2);
 int GetSysVar(SysVar const *v, Value *val);
 int SetSysVar (char const *name, Value *val);
 void DumpSysVarByName (char const *name);
@@ -171,12 +213,15 @@ void SigIntHandler (int d);
 int GotSigInt (void);
 void PurgeEchoLine(char const *fmt, ...);
 void FreeTrig(Trigger *t);
+int CopyTrigger(Trigger *dest, Trigger const *src);
 void AppendTag(DynamicBuffer *buf, char const *s);
 char const *SynthesizeTag(void);
 void SaveLastTrigger(Trigger const *t);
 void SaveAllTriggerInfo(Trigger const *t, TimeTrig const *tt, int trigdate, int trigtime, int valid);
 
 void PerIterationInit(void);
+void ReloadReminders(void);
+int RerunChangedFiles(void);
 char const *Decolorize(void);
 char const *Colorize(int r, int g, int b, int bg, int clamp);
 void PrintJSONString(char const *s);
@@ -235,6 +280,7 @@ void InitDedupeTable(void);
 void InitVars(void);
 void InitUserFunctions(void);
 void InitTranslationTable(void);
+void ClearTranslationTable(void);
 void InitFiles(void);
 char const *GetTranslatedString(char const *orig);
 int GetTranslatedStringTryingVariants(char const *orig, DynamicBuffer *out);
@@ -277,6 +323,16 @@ int system_to_stderr(char const *cmd);
 int system1(char const *cmd);
 int tz_set_tz (char const *tz);
 int tz_convert(int year, int month, int day, int hour, int minute, char const *src_tz, char const *tgt_tz, struct tm *tm);
+void tz_set_active(char const *tz);
+char const *tz_get_active(void);
+time_t tz_mktime(struct tm *tm);
+time_t tz_mktime_in(char const *tz, struct tm *tm);
+struct tm *tz_localtime_r(time_t const *t, struct tm *tm);
+struct tm *tz_localtime_in(char const *tz, time_t const *t, struct tm *tm);
+void tz_abbrev(time_t t, char *buf, size_t len);
+void print_tz_stats(void);
+void print_shell_cache_stats(void);
+void ClearShellCache(void);
 int AdjustTriggerForTimeZone(Trigger *trig, int dse, TimeTrig *tim, int debug_ok);
 void EnterTimezone(char const *tz);
 void ExitTimezone(char const *tz);
@@ -42,6 +42,7 @@ static int setup_inotify_watch(void);
 /* List structure for holding queued reminders */
 typedef struct queuedrem {
     struct queuedrem *next;
+    struct queuedrem *prev;
     int typ;
     int RunDisabled;
     int ntrig;
@@ -56,20 +57,36 @@ typedef struct queuedrem {
     TimeTrig tt;
     int red, green, blue;
     int qid;
+    int heap_index;
 } QueuedRem;
 
 /* Global variables */
 
 static QueuedRem *QueueHead = NULL;
+
+/* Queued reminders that have a next trigger time, kept in a binary
+   min-heap ordered by tt.nextdtime so the next one to issue is
+   always QueueHeap[0] */
+static QueuedRem **QueueHeap = NULL;
+static int QueueHeapLen = 0;
+
+/* Queued reminders indexed by qid; qids are handed out sequentially */
+static QueuedRem **QueueByQid = NULL;
+static int QueueMax = 0;
 static time_t FileModTime;
 static struct stat StatBuf;
 
 static void CheckInitialFile (void);
 static int CalculateNextDtime (QueuedRem *q);
 static QueuedRem *FindNextReminder (void);
+static void SetNextDtime (QueuedRem *q, int dtime);
 static int CalculateNextDtimeUsingSched (QueuedRem *q);
 static void ServerWait (struct timeval *sleep_tv);
 static void reread (void);
+static void reread_changed (void);
+static void rewatch (void);
+static void FreeQueue (void);
+static void InitQueue (int first);
 static void PrintQueue(void);
 
 static int
@@ -123,30 +140,135 @@ static char const *SimpleTimeNoSpace(int tim)
     return s;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  Heap maintenance.  Ties on nextdtime go to the reminder    */
+/*  queued last, which is the one nearest the head of the      */
+/*  QueueHead list.                                            */
+/*                                                             */
+/***************************************************************/
+static int heap_before(QueuedRem const *a, QueuedRem const *b)
+{
+    if (a->tt.nextdtime != b->tt.nextdtime) {
+        return a->tt.nextdtime < b->tt.nextdtime;
+    }
+    return a->qid > b->qid;
+}
+
+static void heap_set(int i, QueuedRem *q)
+{
+    QueueHeap[i] = q;
+    q->heap_index = i;
+}
+
+static void heap_sift_up(int i)
+{
+    QueuedRem *q = QueueHeap[i];
+    while (i > 0 && heap_before(q, QueueHeap[(i-1)/2])) {
+        heap_set(i, QueueHeap[(i-1)/2]);
+        i = (i-1)/2;
+    }
+    heap_set(i, q);
+}
+
+static void heap_sift_down(int i)
+{
+    QueuedRem *q = QueueHeap[i];
+    int kid;
+    while ((kid = 2*i+1) < QueueHeapLen) {
+        if (kid+1 < QueueHeapLen &&
+            heap_before(QueueHeap[kid+1], QueueHeap[kid])) {
+            kid++;
+        }
+        if (!heap_before(QueueHeap[kid], q)) break;
+        heap_set(i, QueueHeap[kid]);
+        i = kid;
+    }
+    heap_set(i, q);
+}
+
+static void heap_remove(QueuedRem *q)
+{
+    int i = q->heap_index;
+    if (i < 0) return;
+    q->heap_index = -1;
+    QueueHeapLen--;
+    if (i < QueueHeapLen) {
+        heap_set(i, QueueHeap[QueueHeapLen]);
+        heap_sift_up(i);
+        heap_sift_down(QueueHeap[i]->heap_index);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SetNextDtime                                               */
+/*                                                             */
+/*  Set the next trigger time of a queued reminder and move it */
+/*  to the right place in the heap.                            */
+/*                                                             */
+/***************************************************************/
+static void SetNextDtime(QueuedRem *q, int dtime)
+{
+    q->tt.nextdtime = dtime;
+    if (dtime == NO_DATETIME) {
+        heap_remove(q);
+    } else if (q->heap_index < 0) {
+        /* QueueReminder made sure there's room */
+        heap_set(QueueHeapLen, q);
+        QueueHeapLen++;
+        heap_sift_up(q->heap_index);
+    } else {
+        heap_sift_up(q->heap_index);
+        heap_sift_down(q->heap_index);
+    }
+}
+
 static void del_reminder(int qid)
 {
-    QueuedRem *q = QueueHead;
-    QueuedRem *next;
+    QueuedRem *q;
+
+    if (qid < 0 || qid >= NumQueued) {
+        return;
+    }
+    q = QueueByQid[qid];
     if (!q) {
         return;
     }
-    if (q->qid == qid) {
+    QueueByQid[qid] = NULL;
+    heap_remove(q);
+    if (q->prev) {
+        q->prev->next = q->next;
+    } else {
         QueueHead = q->next;
-        if (q->text) free((void *) q->text);
-        FreeTrig(&(q->t));
-        free(q);
-        return;
     }
-    while(q->next) {
+    if (q->next) {
+        q->next->prev = q->prev;
+    }
+    if (q->text) free((void *) q->text);
+    FreeTrig(&(q->t));
+    free(q);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DequeueRemindersFrom                                       */
+/*                                                             */
+/*  Throw away the queued reminders that came from fname,      */
+/*  because we are about to run it again.                      */
+/*                                                             */
+/***************************************************************/
+void DequeueRemindersFrom(char const *fname)
+{
+    QueuedRem *q = QueueHead;
+    QueuedRem *next;
+
+    while (q) {
         next = q->next;
-        if (q->next->qid == qid) {
-            q->next = q->next->next;
-            if (next->text) free((void *) next->text);
-            FreeTrig(&(next->t));
-            free(next);
-            return;
+        if (!strcmp(q->fname, fname)) {
+            del_reminder(q->qid);
         }
-        q = q->next;
+        q = next;
     }
 }
 
@@ -164,6 +286,23 @@ int QueueReminder(ParsePtr p, Trigger *trig,
     QueuedRem *qelem;
     TrigInfo *ti;
 
+    /* Make room to index the new reminder by qid, and in the heap */
+    if (NumQueued >= QueueMax) {
+        int n = QueueMax ? QueueMax * 2 : 64;
+        QueuedRem **by_qid, **heap;
+        by_qid = realloc(QueueByQid, n * sizeof(QueuedRem *));
+        if (!by_qid) {
+            return E_NO_MEM;
+        }
+        QueueByQid = by_qid;
+        heap = realloc(QueueHeap, n * sizeof(QueuedRem *));
+        if (!heap) {
+            return E_NO_MEM;
+        }
+        QueueHeap = heap;
+        QueueMax = n;
+    }
+
     qelem = NEW(QueuedRem);
     if (!qelem) {
         return E_NO_MEM;
@@ -181,6 +320,8 @@ int QueueReminder(ParsePtr p, Trigger *trig,
     qelem->lineno = LineNo;
     qelem->lineno_start = LineNoStart;
     qelem->qid = NumQueued;
+    qelem->heap_index = -1;
+    QueueByQid[NumQueued] = qelem;
     NumQueued++;
     qelem->typ = trig->typ;
     strcpy(qelem->passthru, trig->passthru);
@@ -201,6 +342,10 @@ int QueueReminder(ParsePtr p, Trigger *trig,
         AppendTag(&(qelem->t.tags), SynthesizeTag());
     }
     qelem->next = QueueHead;
+    qelem->prev = NULL;
+    if (QueueHead) {
+        QueueHead->prev = qelem;
+    }
     qelem->RunDisabled = RunDisabled;
     qelem->ntrig = 0;
     strcpy(qelem->sched, sched);
@@ -241,14 +386,7 @@ SigContHandler(int d)
 static void
 print_num_queued(void)
 {
-        int nqueued = 0;
-        QueuedRem *q = QueueHead;
-        while(q) {
-            if (q->tt.nextdtime != NO_DATETIME) {
-                nqueued++;
-            }
-            q = q->next;
-        }
+        int nqueued = QueueHeapLen;
         if (DaemonJSON) {
             printf("{");
             PrintJSONKeyPairString("response", "queued");
@@ -290,8 +428,7 @@ reread_because_of_sighup(void)
 /***************************************************************/
 void HandleQueuedReminders(void)
 {
-    QueuedRem *q = QueueHead;
-    QueuedRem *next;
+    QueuedRem *q;
     int TimeToSleep;
     unsigned SleepTime;
     Parser p;
@@ -299,9 +436,6 @@ void HandleQueuedReminders(void)
     struct timeval sleep_tv;
     struct sigaction sa;
 
-    /* Disable any potential pending SIGALRMs */
-    alarm(0);
-
     /* Un-limit execution time */
     unlimit_execution_time();
 
@@ -339,21 +473,7 @@ void HandleQueuedReminders(void)
     }
 
     /* Initialize the queue - initialize all the entries time of issue */
-
-    while (q) {
-        next = q->next;
-        q->tt.nextdtime = NO_DATETIME;
-        q->tt.nextdtime = CalculateNextDtime(q);
-        /* If it won't be issued, delete it */
-        if (q->tt.nextdtime == NO_DATETIME) {
-            del_reminder(q->qid);
-        } else if (Daemon && (q->tt.nextdtime / MINUTES_PER_DAY) > DSEToday) {
-            /* If we are in daemon mode and it won't trigger today,
-               don't bother queueing it */
-            del_reminder(q->qid);
-        }
-        q = next;
-    }
+    InitQueue(0);
 
     if (ShouldFork || Daemon) {
         sa.sa_handler = SigIntHandler;
@@ -413,8 +533,6 @@ void HandleQueuedReminders(void)
                     sleep_tv.tv_usec = 0;
                 }
                 ServerWait(&sleep_tv);
-                /* A DEL command might have deleted our queued reminder! */
-                q = FindNextReminder();
             } else {
                 sleep(SleepTime);
             }
@@ -430,6 +548,11 @@ void HandleQueuedReminders(void)
                 CheckInitialFile();
             }
 
+            /* A DEL command or a reread might have deleted our
+               queued reminder! */
+            q = FindNextReminder();
+            if (!q && !Daemon) break;
+
             if (Daemon && !q) {
                 if (IsServerMode()) {
                     /* Sleep until midnight */
@@ -446,6 +569,7 @@ void HandleQueuedReminders(void)
             }
 
         }
+        if (!q) continue;
 
         /* Do NOT trigger the reminder if tt.nextdtime is more than a
            minute in the past.  This can happen if the clock is
@@ -514,16 +638,17 @@ void HandleQueuedReminders(void)
         }
 
         /* Calculate the next trigger time */
-        q->tt.nextdtime = CalculateNextDtime(q);
+        int nextdtime = CalculateNextDtime(q);
 
-        if (q->tt.nextdtime != NO_DATETIME) {
+        if (nextdtime != NO_DATETIME) {
             /* If trigger time is way in the past because computer has been
                suspended or hibernated, remove from queue */
             if ((GetQDateTime(q) < SystemDateTime(1) - MaxLateMinutes) &&
-                (q->tt.nextdtime < SystemDateTime(1) - MaxLateMinutes)) {
-                q->tt.nextdtime = NO_DATETIME;
+                (nextdtime < SystemDateTime(1) - MaxLateMinutes)) {
+                nextdtime = NO_DATETIME;
             }
         }
+        SetNextDtime(q, nextdtime);
 
         /* If queued reminder has expired, actually remove it from queue
            and update status */
@@ -602,17 +727,8 @@ static int CalculateNextDtime(QueuedRem *q)
 /***************************************************************/
 static QueuedRem *FindNextReminder(void)
 {
-    QueuedRem *q = QueueHead;
-    QueuedRem *ans = NULL;
-
-    while (q) {
-        if (q->tt.nextdtime != NO_DATETIME) {
-            if (!ans) ans = q;
-            else if (q->tt.nextdtime < ans->tt.nextdtime) ans = q;
-        }
-        q = q->next;
-    }
-    return ans;
+    if (!QueueHeapLen) return NULL;
+    return QueueHeap[0];
 }
 
 
@@ -677,7 +793,6 @@ static void CheckInitialFile(void)
             n = read(watch_fd, buf, sizeof(buf));
             if (n < 0 && errno == EINTR) continue;
             if (n > 0) {
-                close(watch_fd);
                 reread();
             }
             break;
@@ -898,7 +1013,7 @@ static void ServerWait(struct timeval *sleep_tv)
                 printf("NOTE newdate\nNOTE reread\n");
             }
             fflush(stdout);
-            reread();
+            reread_changed();
         }
     }
 #endif
@@ -1051,16 +1166,116 @@ static void ServerWait(struct timeval *sleep_tv)
     }
 }
 
+/***************************************************************/
+/*                                                             */
+/*  InitQueue                                                  */
+/*                                                             */
+/*  Work out when each queued reminder with a qid of at least  */
+/*  first is next issued, and drop the ones that won't be.     */
+/*                                                             */
+/***************************************************************/
+static void InitQueue(int first)
+{
+    QueuedRem *q = QueueHead;
+    QueuedRem *next;
+
+    while (q) {
+        next = q->next;
+        if (q->qid < first) {
+            q = next;
+            continue;
+        }
+        q->tt.nextdtime = NO_DATETIME;
+        SetNextDtime(q, CalculateNextDtime(q));
+        /* If it won't be issued, delete it */
+        if (q->tt.nextdtime == NO_DATETIME) {
+            del_reminder(q->qid);
+        } else if (Daemon && (q->tt.nextdtime / MINUTES_PER_DAY) > DSEToday) {
+            /* If we are in daemon mode and it won't trigger today,
+               don't bother queueing it */
+            del_reminder(q->qid);
+        }
+        q = next;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FreeQueue                                                  */
+/*                                                             */
+/*  Throw away every queued reminder.                          */
+/*                                                             */
+/***************************************************************/
+static void FreeQueue(void)
+{
+    QueuedRem *q = QueueHead;
+    QueuedRem *next;
+
+    while (q) {
+        next = q->next;
+        if (q->text) free((void *) q->text);
+        FreeTrig(&(q->t));
+        free(q);
+        q = next;
+    }
+    QueueHead = NULL;
+    QueueHeapLen = 0;
+    NumQueued = 0;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  reread                                                     */
 /*                                                             */
-/*  Restarts Remind if date rolls over or REREAD cmd received  */
+/*  Reload the reminders if date rolls over or REREAD cmd      */
+/*  received.  This happens in-process; files that have not    */
+/*  changed are not read from disk again.                      */
 /*                                                             */
 /***************************************************************/
 static void reread(void)
 {
-    execvp(ArgV[0], (char **) ArgV);
+    FreeQueue();
+    ReloadReminders();
+    InitQueue(0);
+    rewatch();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  reread_changed                                             */
+/*                                                             */
+/*  Files we watch have changed.  Re-run just the ones that    */
+/*  changed if we can, or reload everything if we can't.       */
+/*                                                             */
+/***************************************************************/
+static void reread_changed(void)
+{
+    int first = NumQueued;
+
+    if (!RerunChangedFiles()) {
+        reread();
+        return;
+    }
+    InitQueue(first);
+    rewatch();
+}
+
+static void rewatch(void)
+{
+    if (Daemon > 0 && !stat(InitialFile, &StatBuf)) {
+        FileModTime = StatBuf.st_mtime;
+    }
+#ifdef USE_INOTIFY
+    /* The reminder file may have been replaced rather than
+       modified, so watch whatever is there now */
+    if (watch_fd >= 0) {
+        close(watch_fd);
+        watch_fd = -1;
+    }
+    if (IsServerMode()) {
+        watch_fd = setup_inotify_watch();
+    }
+#endif
 }
 
 #ifdef USE_INOTIFY
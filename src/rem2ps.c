@@ -13,6 +13,7 @@
 #include "version.h"
 #include "config.h"
 #include "dynbuf.h"
+#include "err.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -156,11 +157,157 @@ put_escaped_string(char const *s)
 
 /***************************************************************/
 /*                                                             */
-/*   Parse the new-style JSON intermediate format              */
+/*   A small pull scanner for the flat JSON objects that       */
+/*   remind -pp emits.  It pulls out the few fields we need    */
+/*   straight from the line instead of having json_parse()     */
+/*   build (and free) a tree for every calendar entry.         */
+/*                                                             */
+/***************************************************************/
+static char const *
+json_skip_ws(char const *s)
+{
+    while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r') s++;
+    return s;
+}
+
+static int
+json_hex4(char const *s, unsigned int *val)
+{
+    int i;
+    *val = 0;
+    for (i=0; i<4; i++) {
+        *val <<= 4;
+        if (s[i] >= '0' && s[i] <= '9') *val |= s[i] - '0';
+        else if (s[i] >= 'a' && s[i] <= 'f') *val |= s[i] - 'a' + 10;
+        else if (s[i] >= 'A' && s[i] <= 'F') *val |= s[i] - 'A' + 10;
+        else return 0;
+    }
+    return 1;
+}
+
+/* Scan the string starting at the opening quote s, decoding it into
+   out (which may be NULL if we only want to skip it).  Returns a
+   pointer just past the closing quote, or NULL if the string is
+   malformed.  \u escapes become UTF-8, as json_parse() does. */
+static char const *
+json_scan_string(char const *s, DynamicBuffer *out)
+{
+    char const *run;
+    unsigned int uc, uc2;
+
+    s++;
+    while (1) {
+        run = s;
+        while (*s && *s != '"' && *s != '\\') s++;
+        if (out) {
+            while (run < s) {
+                if (DBufPutc(out, *run) != OK) return NULL;
+                run++;
+            }
+        }
+        if (!*s) return NULL;
+        if (*s == '"') return s+1;
+        s++;
+        switch(*s) {
+        case 'b': uc = '\b'; break;
+        case 'f': uc = '\f'; break;
+        case 'n': uc = '\n'; break;
+        case 'r': uc = '\r'; break;
+        case 't': uc = '\t'; break;
+        case 'u':
+            if (!json_hex4(s+1, &uc)) return NULL;
+            s += 4;
+            if ((uc & 0xF800) == 0xD800) {
+                if (s[1] != '\\' || s[2] != 'u' || !json_hex4(s+3, &uc2)) {
+                    return NULL;
+                }
+                s += 6;
+                uc = 0x010000 | ((uc & 0x3FF) << 10) | (uc2 & 0x3FF);
+            }
+            break;
+        case 0:
+            return NULL;
+        default:
+            uc = (unsigned char) *s;
+            break;
+        }
+        s++;
+        if (!out) continue;
+        if (uc <= 0x7F) {
+            DBufPutc(out, (char) uc);
+        } else if (uc <= 0x7FF) {
+            DBufPutc(out, (char) (0xC0 | (uc >> 6)));
+            DBufPutc(out, (char) (0x80 | (uc & 0x3F)));
+        } else if (uc <= 0xFFFF) {
+            DBufPutc(out, (char) (0xE0 | (uc >> 12)));
+            DBufPutc(out, (char) (0x80 | ((uc >> 6) & 0x3F)));
+            DBufPutc(out, (char) (0x80 | (uc & 0x3F)));
+        } else {
+            DBufPutc(out, (char) (0xF0 | (uc >> 18)));
+            DBufPutc(out, (char) (0x80 | ((uc >> 12) & 0x3F)));
+            DBufPutc(out, (char) (0x80 | ((uc >> 6) & 0x3F)));
+            DBufPutc(out, (char) (0x80 | (uc & 0x3F)));
+        }
+    }
+}
+
+/* Skip over any JSON value, including nested arrays and objects */
+static char const *
+json_skip_value(char const *s)
+{
+    int depth = 0;
+
+    do {
+        s = json_skip_ws(s);
+        switch(*s) {
+        case '"':
+            s = json_scan_string(s, NULL);
+            if (!s) return NULL;
+            break;
+        case '{':
+        case '[':
+            depth++;
+            s++;
+            break;
+        case '}':
+        case ']':
+            if (!depth) return NULL;
+            depth--;
+            s++;
+            break;
+        case ',':
+        case ':':
+            if (!depth) return NULL;
+            s++;
+            break;
+        case 0:
+            return NULL;
+        default:
+            if (!strncmp(s, "true", 4) || !strncmp(s, "null", 4)) {
+                s += 4;
+            } else if (!strncmp(s, "false", 5)) {
+                s += 5;
+            } else if (*s == '-' || isdigit((unsigned char) *s)) {
+                s++;
+                while (*s && strchr("0123456789.eE+-", *s)) s++;
+            } else {
+                return NULL;
+            }
+            break;
+        }
+    } while (depth);
+    return s;
+}
+
+/***************************************************************/
+/*                                                             */
+/*   Parse the new-style JSON intermediate format with the     */
+/*   full json_parse() tree builder.  Used for anything the    */
+/*   fast scanner below doesn't understand.                    */
 /*                                                             */
 /***************************************************************/
 static CalEntry *
-JSONToCalEntry(DynamicBuffer const *buf)
+JSONToCalEntryFull(DynamicBuffer const *buf)
 {
     CalEntry *c;
     json_value *val;
@@ -240,6 +387,122 @@ JSONToCalEntry(DynamicBuffer const *buf)
     return c;
 }
 
+/***************************************************************/
+/*                                                             */
+/*   Parse the new-style JSON intermediate format              */
+/*                                                             */
+/***************************************************************/
+static CalEntry *
+JSONToCalEntry(DynamicBuffer const *buf)
+{
+    CalEntry *c;
+    DynamicBuffer key, val;
+    char const *s, *v;
+    int got_date = 0, got_body = 0;
+
+    s = json_skip_ws(DBufValue(buf));
+    if (*s != '{') {
+        return JSONToCalEntryFull(buf);
+    }
+
+    c = NEW(CalEntry);
+    if (!c) {
+        fprintf(stderr, "malloc failed - aborting.\n");
+        exit(EXIT_FAILURE);
+    }
+    c->next = NULL;
+    c->special = SPECIAL_NORMAL;
+    c->entry = NULL;
+
+    DBufInit(&key);
+    DBufInit(&val);
+    s = json_skip_ws(s+1);
+    if (*s == '}') {
+        s++;
+    } else {
+        while (s) {
+            if (*s != '"') {
+                s = NULL;
+                break;
+            }
+            DBufFree(&key);
+            s = json_scan_string(s, &key);
+            if (!s) break;
+            s = json_skip_ws(s);
+            if (*s != ':') {
+                s = NULL;
+                break;
+            }
+            s = json_skip_ws(s+1);
+            if (*s == '"' &&
+                (!strcmp(DBufValue(&key), "date") ||
+                 !strcmp(DBufValue(&key), "body") ||
+                 !strcmp(DBufValue(&key), "passthru"))) {
+                DBufFree(&val);
+                s = json_scan_string(s, &val);
+                if (!s) break;
+                v = DBufValue(&val);
+                if (!strcmp(DBufValue(&key), "date")) {
+                    c->daynum = (v[8] - '0') * 10 + v[9] - '0';
+                    got_date = 1;
+                } else if (!strcmp(DBufValue(&key), "body")) {
+                    free(c->entry);
+                    c->entry = malloc(strlen(v)+1);
+                    if (!c->entry) {
+                        fprintf(stderr, "malloc failed - aborting.\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    strcpy(c->entry, v);
+                    got_body = 1;
+                } else if (!strcasecmp(v, "PostScript")) {
+                    c->special = SPECIAL_POSTSCRIPT;
+                } else if (!strcasecmp(v, "SHADE")) {
+                    c->special = SPECIAL_SHADE;
+                } else if (!strcasecmp(v, "MOON")) {
+                    c->special = SPECIAL_MOON;
+                } else if (!strcasecmp(v, "WEEK")) {
+                    c->special = SPECIAL_WEEK;
+                } else if (!strcasecmp(v, "PSFile")) {
+                    c->special = SPECIAL_PSFILE;
+                } else if (!strcasecmp(v, "COLOUR") ||
+                           !strcasecmp(v, "COLOR")) {
+                    c->special = SPECIAL_COLOR;
+                } else {
+                    c->special = SPECIAL_UNKNOWN;
+                }
+            } else {
+                s = json_skip_value(s);
+                if (!s) break;
+            }
+            s = json_skip_ws(s);
+            if (*s == '}') {
+                s++;
+                break;
+            }
+            if (*s != ',') {
+                s = NULL;
+                break;
+            }
+            s = json_skip_ws(s+1);
+        }
+    }
+    DBufFree(&key);
+    DBufFree(&val);
+
+    if (!s || *json_skip_ws(s)) {
+        /* Let the full parser accept it or explain what's wrong */
+        free(c->entry);
+        free(c);
+        return JSONToCalEntryFull(buf);
+    }
+
+    if (!got_body || !got_date) {
+        fprintf(stderr, "Could not parse line `%s'\n", DBufValue(buf));
+        exit(EXIT_FAILURE);
+    }
+    return c;
+}
+
 /***************************************************************/
 /*                                                             */
 /*   Parse the old-style REM2PS intermediate format            */
@@ -14,6 +14,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 
 #include <stdlib.h>
 #include "types.h"
@@ -23,7 +24,7 @@
 
 /* The structure of a sorted entry */
 typedef struct sortrem {
-    struct sortrem *next;
+    uint64_t key;
     char const *text;
     char const *url;
     int trigdate;
@@ -32,35 +33,69 @@ typedef struct sortrem {
     int priority;
 } Sortrem;
 
-/* The sorted reminder queue */
-static Sortrem *SortedQueue = (Sortrem *) NULL;
+/* The sort buffer.  Reminders are appended in the order they are
+   issued and sorted just once, by IssueSortedReminders() */
+static Sortrem *SortBuf = NULL;
+static int NumSorted = 0;
+static int MaxSorted = 0;
 
-static Sortrem *MakeSortRem (int dse, int tim, char const *url, char const *body, int typ, int prio);
+static uint64_t SortKey (int dse, int tim, int prio);
+static void MergeSort (Sortrem *a, Sortrem *tmp, int n);
 static void IssueSortBanner (int dse);
 
 /***************************************************************/
 /*                                                             */
-/*  MakeSortRem                                                */
+/*  SortKey                                                    */
 /*                                                             */
-/*  Create a new Sortrem entry - return NULL on failure.       */
+/*  Pack a reminder's date, time and priority into a key that  */
+/*  sorts in ascending order exactly as CompareRems would sort */
+/*  it with the current sorting options.  From the top: 32     */
+/*  bits of date, one bit for timed vs. untimed, 16 bits of    */
+/*  time and 15 bits of priority.                              */
 /*                                                             */
 /***************************************************************/
-static Sortrem *MakeSortRem(int dse, int tim, char const *url, char const *body, int typ, int prio)
+static uint64_t SortKey(int dse, int tim, int prio)
 {
-    Sortrem *srem = NEW(Sortrem);
-    if (!srem) return NULL;
+    uint64_t d = (uint32_t) dse;
+    uint64_t timed = (tim != NO_TIME);
+    uint64_t t = (tim != NO_TIME) ? (uint64_t) (tim & 0xFFFF) : 0;
+    uint64_t p = (uint64_t) (prio & 0x7FFF);
 
-    srem->text = strdup(body);
-    if (!srem->text) {
-        free(srem);
-        return NULL;
+    if (SortByDate == SORT_DESCEND) d = 0xFFFFFFFFU - d;
+    if (!UntimedBeforeTimed) timed = !timed;
+    if (SortByTime == SORT_DESCEND) t = 0xFFFF - t;
+    if (SortByPrio == SORT_DESCEND) p = 0x7FFF - p;
+
+    return (d << 32) | (timed << 31) | (t << 15) | p;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  InsertIntoSortBuffer                                       */
+/*                                                             */
+/*  Insert a reminder into the sort buffer                     */
+/*                                                             */
+/***************************************************************/
+int InsertIntoSortBuffer(int dse, int tim, char const *url, char const *body, int typ, int prio)
+{
+    Sortrem *srem;
+
+    if (NumSorted >= MaxSorted) {
+        int n = MaxSorted ? MaxSorted * 2 : 64;
+        srem = realloc(SortBuf, n * sizeof(Sortrem));
+        if (!srem) goto nomem;
+        SortBuf = srem;
+        MaxSorted = n;
     }
+
+    srem = &SortBuf[NumSorted];
+    srem->text = strdup(body);
+    if (!srem->text) goto nomem;
     if (url) {
         srem->url = strdup(url);
         if (!srem->url) {
             free((char *) srem->text);
-            free(srem);
-            return NULL;
+            goto nomem;
         }
     } else {
         srem->url = NULL;
@@ -70,61 +105,55 @@ static Sortrem *MakeSortRem(int dse, int tim, char const *url, char const *body,
     srem->trigtime = tim;
     srem->typ = typ;
     srem->priority = prio;
-    srem->next = NULL;
-    return srem;
+    srem->key = SortKey(dse, tim, prio);
+    NumSorted++;
+    return OK;
+
+  nomem:
+    Eprint("%s", GetErr(E_NO_MEM));
+    IssueSortedReminders();
+    SortByDate = 0;
+    SortByTime = 0;
+    SortByPrio = 0;
+    UntimedBeforeTimed = 0;
+    return E_NO_MEM;
 }
 
 /***************************************************************/
 /*                                                             */
-/*  InsertIntoSortBuffer                                       */
+/*  MergeSort                                                  */
 /*                                                             */
-/*  Insert a reminder into the sort buffer                     */
+/*  Sort the n entries of a by key, keeping entries with equal */
+/*  keys in the order they were inserted.  tmp must have room  */
+/*  for n entries.                                             */
 /*                                                             */
 /***************************************************************/
-int InsertIntoSortBuffer(int dse, int tim, char const *url, char const *body, int typ, int prio)
+static void MergeSort(Sortrem *a, Sortrem *tmp, int n)
 {
-    Sortrem *srem = MakeSortRem(dse, tim, url, body, typ, prio);
-    Sortrem *cur = SortedQueue, *prev = NULL;
-    int ShouldGoAfter;
-
-    if (!srem) {
-        Eprint("%s", GetErr(E_NO_MEM));
-        IssueSortedReminders();
-        SortByDate = 0;
-        SortByTime = 0;
-        SortByPrio = 0;
-        UntimedBeforeTimed = 0;
-        return E_NO_MEM;
-    }
+    int mid = n / 2;
+    int i, j, k;
 
-    /* Find the correct place in the sorted list */
-    if (!SortedQueue) {
-        SortedQueue = srem;
-        return OK;
-    }
-    while (cur) {
-        ShouldGoAfter = CompareRems(srem->trigdate, srem->trigtime, srem->priority,
-                                    cur->trigdate, cur->trigtime, cur->priority,
-                                    SortByDate, SortByTime, SortByPrio, UntimedBeforeTimed);
-
-        if (ShouldGoAfter <= 0) {
-            prev = cur;
-            cur = cur->next;
+    if (n < 2) return;
+    MergeSort(a, tmp, mid);
+    MergeSort(a + mid, tmp, n - mid);
+
+    /* Already in order?  Common when reminders are issued by date */
+    if (a[mid-1].key <= a[mid].key) return;
+
+    memcpy(tmp, a, mid * sizeof(Sortrem));
+    i = 0;
+    j = mid;
+    k = 0;
+    while (i < mid && j < n) {
+        if (a[j].key < tmp[i].key) {
+            a[k++] = a[j++];
         } else {
-            if (prev) {
-                prev->next = srem;
-                srem->next = cur;
-            } else {
-                SortedQueue = srem;
-                srem->next = cur;
-            }
-            return OK;
+            a[k++] = tmp[i++];
         }
-
     }
-    prev->next = srem;
-    srem->next = cur;  /* For safety - actually redundant */
-    return OK;
+    while (i < mid) {
+        a[k++] = tmp[i++];
+    }
 }
 
 /***************************************************************/
@@ -136,12 +165,24 @@ int InsertIntoSortBuffer(int dse, int tim, char const *url, char const *body, in
 /***************************************************************/
 void IssueSortedReminders(void)
 {
-    Sortrem *cur = SortedQueue;
-    Sortrem *next;
+    Sortrem *cur;
+    Sortrem *tmp;
     int olddate = NO_DATE;
+    int i;
+
+    if (NumSorted > 1) {
+        tmp = malloc((NumSorted / 2) * sizeof(Sortrem));
+        if (tmp) {
+            MergeSort(SortBuf, tmp, NumSorted);
+            free(tmp);
+        } else {
+            /* Issue them unsorted rather than not at all */
+            Eprint("%s", GetErr(E_NO_MEM));
+        }
+    }
 
-    while (cur) {
-        next = cur->next;
+    for (i=0; i<NumSorted; i++) {
+        cur = &SortBuf[i];
         switch(cur->typ) {
         case MSG_TYPE:
             if (MsgCommand && *MsgCommand) {
@@ -178,10 +219,8 @@ void IssueSortedReminders(void)
         if (cur->url) {
             free((char *) cur->url);
         }
-        free(cur);
-        cur = next;
     }
-    SortedQueue = NULL;
+    NumSorted = 0;
 }
 /***************************************************************/
 /*                                                             */
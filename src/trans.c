@@ -163,7 +163,7 @@ RemoveTranslationNoResize(XlateItem *item)
 /*  ClearTranslationTable - free all translation items         */
 /*                                                             */
 /***************************************************************/
-static void
+void
 ClearTranslationTable(void)
 {
     XlateItem *item;
@@ -433,6 +433,7 @@ DoTranslate(ParsePtr p)
     DBufInit(&translated);
     int c;
 
+    DepOpaque();
     c = ParseNonSpaceChar(p, &r, 1);
     if (r) return r;
     if (c == 0) {
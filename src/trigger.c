@@ -206,7 +206,7 @@ static int NextSimpleTrig(int startdate, Trigger const *trig, int *err)
         /* Must be next month */
         if (m == 11) return -1;
         m++;
-        while (trig->d > DaysInMonth(m, trig->d)) m++;
+        while (trig->d > DaysInMonth(m, trig->y)) m++;
         j = DSE(trig->y, m, trig->d);
         ADVANCE_TO_WD(j, trig->wd);
         if (DSEYear(j) > trig->y) return -1;
@@ -335,22 +335,30 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
        until we're at the start of a block of holidays */
     if (trig->skip == AFTER_SKIP) {
         int iter = 0;
-        while (iter++ <= MaxSatIter) {
-            *err = IsOmitted(start-1, trig->localomit, trig->omitfunc, &omit);
-            if (*err) return -2;
-            if (!omit) {
-                break;
+        int d = -1;
+        if (!*trig->omitfunc && start > 0) {
+            d = NextNonOmitted(start-1, -1, trig->localomit, MaxSatIter);
+        }
+        if (d >= 0) {
+            start = d+1;
+        } else {
+            while (iter++ <= MaxSatIter) {
+                *err = IsOmitted(start-1, trig->localomit, trig->omitfunc, &omit);
+                if (*err) return -2;
+                if (!omit) {
+                    break;
+                }
+                start--;
+                if (start < 0) {
+                    break;
+                }
             }
-            start--;
-            if (start < 0) {
-                break;
+            if (start < 0 || iter > MaxSatIter) {
+                /* omitfunc must have returned "true" too often */
+                *err = E_CANT_TRIG;
+                return -2;
             }
         }
-        if (start < 0 || iter > MaxSatIter) {
-            /* omitfunc must have returned "true" too often */
-            *err = E_CANT_TRIG;
-            return -2;
-        }
     }
 
     /* Find the next simple trigger */
@@ -371,21 +379,29 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
         else {
             int iter = 0;
             int max = MaxSatIter;
+            int d = -1;
             if (max < mod*2) {
                 max = mod*2;
             }
-            while(iter++ <= max) {
-                if (!mod) {
-                    break;
-                }
-                simple--;
-                *err = IsOmitted(simple, trig->localomit, trig->omitfunc, &omit);
-                if (*err) return -2;
-                if (!omit) mod--;
+            if (!*trig->omitfunc) {
+                d = SlideNonOmitted(simple, -mod, trig->localomit, max-1);
             }
-            if (iter > max) {
-                *err = E_CANT_TRIG;
-                return -2;
+            if (d >= 0) {
+                simple = d;
+            } else {
+                while(iter++ <= max) {
+                    if (!mod) {
+                        break;
+                    }
+                    simple--;
+                    *err = IsOmitted(simple, trig->localomit, trig->omitfunc, &omit);
+                    if (*err) return -2;
+                    if (!omit) mod--;
+                }
+                if (iter > max) {
+                    *err = E_CANT_TRIG;
+                    return -2;
+                }
             }
         }
     }
@@ -402,38 +418,54 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
     /* If it's a "BEFORE"-type skip, back up */
     if (trig->skip == BEFORE_SKIP) {
         int iter = 0;
-        while(iter++ <= MaxSatIter) {
-            *err = IsOmitted(simple, trig->localomit, trig->omitfunc, &omit);
-            if (*err) return -2;
-            if (!omit) {
-                break;
+        int d = -1;
+        if (!*trig->omitfunc) {
+            d = NextNonOmitted(simple, -1, trig->localomit, MaxSatIter);
+        }
+        if (d >= 0) {
+            simple = d;
+        } else {
+            while(iter++ <= MaxSatIter) {
+                *err = IsOmitted(simple, trig->localomit, trig->omitfunc, &omit);
+                if (*err) return -2;
+                if (!omit) {
+                    break;
+                }
+                simple--;
+                if (simple < 0) {
+                    *err = E_CANT_TRIG;
+                    return -2;
+                }
             }
-            simple--;
-            if (simple < 0) {
+            if (iter > MaxSatIter) {
                 *err = E_CANT_TRIG;
                 return -2;
             }
         }
-        if (iter > MaxSatIter) {
-            *err = E_CANT_TRIG;
-            return -2;
-        }
     }
 
     /* If it's an "AFTER"-type skip, jump ahead */
     if (trig->skip == AFTER_SKIP) {
         int iter = 0;
-        while (iter++ <= MaxSatIter) {
-            *err = IsOmitted(simple, trig->localomit, trig->omitfunc, &omit);
-            if (*err) return -2;
-            if (!omit) {
-                break;
-            }
-            simple++;
+        int d = -1;
+        if (!*trig->omitfunc) {
+            d = NextNonOmitted(simple, 1, trig->localomit, MaxSatIter);
         }
-        if (iter > MaxSatIter) {
-            *err = E_CANT_TRIG;
-            return -2;
+        if (d >= 0) {
+            simple = d;
+        } else {
+            while (iter++ <= MaxSatIter) {
+                *err = IsOmitted(simple, trig->localomit, trig->omitfunc, &omit);
+                if (*err) return -2;
+                if (!omit) {
+                    break;
+                }
+                simple++;
+            }
+            if (iter > MaxSatIter) {
+                *err = E_CANT_TRIG;
+                return -2;
+            }
         }
     }
 
@@ -721,6 +753,155 @@ int ComputeTriggerNoAdjustDuration(int today, Trigger *trig, TimeTrig const *tim
     return -1;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  ComputeTriggerDates                                        */
+/*                                                             */
+/*  Enumerate, in one pass, every trigger date of trig from    */
+/*  "from" through "to" and store them in td.  The first       */
+/*  trigger date after "to" (if any) is stored as well, so     */
+/*  the next trigger on or after any day in the range can be   */
+/*  looked up.  Nothing is saved in the global trigger         */
+/*  variables.  Returns OK or an error code.                   */
+/*                                                             */
+/***************************************************************/
+int ComputeTriggerDates(int from, int to, Trigger *trig, TimeTrig const *tim,
+                        TriggerDates *td)
+{
+    int *dates = NULL, *newdates;
+    int n = 0, alloc = 0;
+    int start = from;
+    int r, err;
+    int expired = trig->expired;
+    int save_debug = DebugFlag;
+
+    FreeTriggerDates(td);
+
+    /* Don't spew debugging output for every date we find */
+    DebugFlag &= ~DB_PRTTRIG;
+    while(1) {
+        r = ComputeTriggerNoAdjustDuration(start, trig, tim, &err, 0, 0);
+        if (err || r < 0) {
+            break;
+        }
+        if (n == alloc) {
+            alloc = alloc ? alloc * 2 : 16;
+            newdates = realloc(dates, alloc * sizeof(int));
+            if (!newdates) {
+                err = E_NO_MEM;
+                break;
+            }
+            dates = newdates;
+        }
+        dates[n++] = r;
+        if (r > to) {
+            break;
+        }
+        start = r+1;
+    }
+    DebugFlag = save_debug;
+    trig->expired = expired;
+
+    if (err) {
+        if (dates) free(dates);
+        return err;
+    }
+    td->from = from;
+    td->to = to;
+    td->ndates = n;
+    td->dates = dates;
+    td->max_sat_iter = MaxSatIter;
+    td->omit_hash = GlobalOmitHash();
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ComputeTriggerFromDates                                    */
+/*                                                             */
+/*  Exactly like ComputeTrigger(today, trig, tim, err, 1),     */
+/*  but if the trigger is simple enough, answer from the dates */
+/*  in td, enumerating them through "to" first if need be.     */
+/*  This lets calendar mode find a reminder's trigger dates    */
+/*  once for the whole calendar rather than once per day.      */
+/*                                                             */
+/***************************************************************/
+int ComputeTriggerFromDates(int today, int to, Trigger *trig, TimeTrig *tim,
+                            TriggerDates *td, int *err)
+{
+    int uses_omits;
+    int lo, hi, mid;
+
+    /* Only handle triggers whose next trigger date is simply the
+       first of an ascending list of dates that is on or after
+       "today".  TZ, DURATION, BEFORE, AFTER and OMITFUNC all break
+       that, as does anything that would make ComputeTrigger complain
+       or produce debugging output */
+    if ((DebugFlag & DB_PRTTRIG) ||
+        trig->tz ||
+        trig->duration_days ||
+        *trig->omitfunc ||
+        (trig->skip != NO_SKIP && trig->skip != SKIP_SKIP) ||
+        (WeekdayOmits | trig->localomit) == 0x7F ||
+        today < 0 ||
+        (tim->duration != NO_TIME && tim->ttime == NO_TIME) ||
+        (trig->rep != NO_REP &&
+         (trig->d == NO_DAY || trig->m == NO_MON || trig->y == NO_YR))) {
+        return ComputeTrigger(today, trig, tim, err, 1);
+    }
+
+    /* The dates are stale if the OMIT context they depend on has
+       changed */
+    uses_omits = (trig->back > 0 || trig->skip == SKIP_SKIP);
+    if (td->from == NO_DATE ||
+        today < td->from || today > td->to ||
+        td->max_sat_iter != MaxSatIter ||
+        (uses_omits && td->omit_hash != GlobalOmitHash())) {
+        if (today > to || ComputeTriggerDates(today, to, trig, tim, td) != OK) {
+            FreeTriggerDates(td);
+            return ComputeTrigger(today, trig, tim, err, 1);
+        }
+    }
+
+    /* Find the first date on or after today */
+    lo = 0;
+    hi = td->ndates;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (td->dates[mid] < today) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == td->ndates) {
+        /* Expired; let ComputeTrigger sort out the details */
+        return ComputeTrigger(today, trig, tim, err, 1);
+    }
+
+    *err = OK;
+    trig->expired = 0;
+    return AdjustTriggerForDuration(today, td->dates[lo], trig, tim, 1);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FreeTriggerDates                                           */
+/*                                                             */
+/*  Free the dates in td and mark it empty.                    */
+/*                                                             */
+/***************************************************************/
+void FreeTriggerDates(TriggerDates *td)
+{
+    if (td->dates) {
+        free(td->dates);
+    }
+    td->dates = NULL;
+    td->ndates = 0;
+    td->from = NO_DATE;
+    td->to = NO_DATE;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  NewTrigInfo                                                */
@@ -108,6 +108,10 @@ typedef struct expr_node_struct {
         char name[SHORT_NAME_BUF];
         int (*operator_func) (struct expr_node_struct *node, Value *locals, Value *ans, int *nonconst);
     } u;
+    /* Var or UserFunc this node last resolved to; valid only while
+       bound_gen matches VarBindGeneration or FuncGeneration */
+    void *bound;
+    unsigned int bound_gen;
 } expr_node;
 
 /* Define the structure of a variable */
@@ -179,6 +183,30 @@ typedef struct {
     int duration;
 } TimeTrig;
 
+/* All the trigger dates of a trigger over a range of days */
+typedef struct {
+    int from;                   /* First day covered, or NO_DATE */
+    int to;                     /* Last day covered */
+    int ndates;                 /* Number of trigger dates found */
+    int *dates;                 /* The trigger dates, in ascending order */
+    int max_sat_iter;           /* $MaxSatIter when enumerated */
+    unsigned int omit_hash;     /* GlobalOmitHash() when enumerated */
+} TriggerDates;
+
+/* A REM command compiled once in calendar mode and re-evaluated
+   for each day of the calendar */
+typedef struct {
+    char const *text;           /* Parser text we were compiled from */
+    int body_offset;            /* Offset of body from start of text */
+    char *pushed;               /* Pushed-back token, if any */
+    int default_prio;           /* Values of $DefaultPrio, $DefaultDelta */
+    int default_delta;          /* and $DefaultTDelta when compiled */
+    int default_tdelta;
+    Trigger trig;
+    TimeTrig tim;
+    TriggerDates dates;         /* Trigger dates over the calendar */
+} CompiledRem;
+
 /* The parse pointer */
 typedef struct {
     DynamicBuffer pushedToken;  /* Pushed-back token */
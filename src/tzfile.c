@@ -0,0 +1,808 @@
+/***************************************************************/
+/*                                                             */
+/*  TZFILE.C                                                   */
+/*                                                             */
+/*  Time zone conversions without touching the environment.    */
+/*  Each zone's TZif file is read once into a transition       */
+/*  table; local <-> UTC conversions are then pure table       */
+/*  lookups instead of setenv("TZ") + tzset() + mktime().      */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2026 by Dianne Skoll                    */
+/*  SPDX-License-Identifier: GPL-2.0-only                      */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "types.h"
+#include "protos.h"
+#include "globals.h"
+#include "err.h"
+
+#define SECS_PER_DAY 86400L
+
+/* Where to find TZif files, and the file used when TZ is unset */
+#define TZ_DEFAULT_DIR  "/usr/share/zoneinfo"
+#define TZ_DEFAULT_FILE "/etc/localtime"
+
+/* Don't even try to read absurdly large files */
+#define TZ_MAX_FILE (256 * 1024)
+
+typedef struct {
+    long utoff;        /* Seconds east of UTC */
+    int isdst;
+    int abbr;          /* Index into zone's abbreviation characters */
+} TzType;
+
+/* One rule of a POSIX TZ string: Jn, n or Mm.w.d, plus a time of day */
+typedef struct {
+    char kind;         /* 'J', 'D' or 'M' */
+    int mon, week, day;
+    long secs;
+} TzRule;
+
+typedef struct tz_zone {
+    struct tz_zone *next;
+    char *name;        /* As given in TZ; NULL means TZ unset */
+    int usable;        /* 0 => let the C library handle this zone */
+    int ntrans;
+    long long *trans;  /* Transition instants, ascending */
+    unsigned char *idx;/* Type in effect from each transition on */
+    int ntypes;
+    TzType *types;
+    char *chars;       /* Abbreviations, NUL-separated */
+    int nchars;
+
+    /* Footer: POSIX TZ string for instants after the last transition */
+    int have_footer;
+    int bad_footer;    /* Present but beyond us; ask the C library */
+    int footer_dst;
+    long std_off, dst_off;
+    char std_abbr[16], dst_abbr[16];
+    TzRule start, end;
+} TzZone;
+
+static TzZone *Zones = NULL;
+
+/* The zone that "local time" currently means, and its name as it
+   would appear in TZ (NULL means TZ unset) */
+static TzZone *ActiveZone = NULL;
+static char const *ActiveName = NULL;
+static int ActiveIsSet = 0;
+
+static unsigned int ZonesLoaded = 0;
+static unsigned int ZoneLookups = 0;
+static unsigned int LibcLookups = 0;
+
+/* Days since 1970-01-01 of a proleptic Gregorian date.  Month is 1-12 */
+static long long days_from_civil(long long y, int m, int d)
+{
+    long long era;
+    unsigned yoe, doy, doe;
+
+    y -= (m <= 2);
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = (unsigned) (y - era * 400);
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (long long) doe - 719468;
+}
+
+static void civil_from_days(long long z, long long *y, int *m, int *d)
+{
+    long long era;
+    unsigned doe, yoe, doy, mp;
+
+    z += 719468;
+    era = (z >= 0 ? z : z - 146096) / 146097;
+    doe = (unsigned) (z - era * 146097);
+    yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+    doy = doe - (365*yoe + yoe/4 - yoe/100);
+    mp = (5*doy + 2) / 153;
+    *d = (int) (doy - (153*mp + 2)/5 + 1);
+    *m = (int) (mp < 10 ? mp + 3 : mp - 9);
+    *y = (long long) yoe + era * 400 + (*m <= 2);
+}
+
+static int is_leap(long long y)
+{
+    return (y % 4 == 0) && ((y % 100 != 0) || (y % 400 == 0));
+}
+
+static long get_be32(unsigned char const *p)
+{
+    unsigned long v = ((unsigned long) p[0] << 24) | ((unsigned long) p[1] << 16) |
+        ((unsigned long) p[2] << 8) | (unsigned long) p[3];
+    if (v & 0x80000000UL) {
+        return (long) (v - 0x80000000UL) - 0x7FFFFFFFL - 1;
+    }
+    return (long) v;
+}
+
+static long long get_be64(unsigned char const *p)
+{
+    unsigned long long v = 0;
+    int i;
+    for (i=0; i<8; i++) {
+        v = (v << 8) | p[i];
+    }
+    if (v & 0x8000000000000000ULL) {
+        return (long long) (v - 0x8000000000000000ULL) - 0x7FFFFFFFFFFFFFFFLL - 1;
+    }
+    return (long long) v;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  POSIX TZ strings (the TZif footer)                         */
+/*                                                             */
+/***************************************************************/
+static char const *parse_abbr(char const *s, char *out, size_t len)
+{
+    size_t n = 0;
+    if (*s == '<') {
+        s++;
+        while (*s && *s != '>') {
+            if (n + 1 < len) out[n++] = *s;
+            s++;
+        }
+        if (*s != '>') return NULL;
+        s++;
+    } else {
+        while ((*s >= 'A' && *s <= 'Z') || (*s >= 'a' && *s <= 'z')) {
+            if (n + 1 < len) out[n++] = *s;
+            s++;
+        }
+    }
+    if (n < 3) return NULL;
+    out[n] = 0;
+    return s;
+}
+
+/* [+-]hh[:mm[:ss]] */
+static char const *parse_hms(char const *s, long *secs)
+{
+    int sign = 1;
+    long h = 0, m = 0, sec = 0;
+
+    if (*s == '+') {
+        s++;
+    } else if (*s == '-') {
+        sign = -1;
+        s++;
+    }
+    if (*s < '0' || *s > '9') return NULL;
+    while (*s >= '0' && *s <= '9') h = h * 10 + (*s++ - '0');
+    if (*s == ':') {
+        s++;
+        while (*s >= '0' && *s <= '9') m = m * 10 + (*s++ - '0');
+        if (*s == ':') {
+            s++;
+            while (*s >= '0' && *s <= '9') sec = sec * 10 + (*s++ - '0');
+        }
+    }
+    if (h > 167 || m > 59 || sec > 59) return NULL;
+    *secs = sign * (h * 3600 + m * 60 + sec);
+    return s;
+}
+
+static char const *parse_rule(char const *s, TzRule *r)
+{
+    int n;
+    if (*s == 'J') {
+        r->kind = 'J';
+        s++;
+    } else if (*s == 'M') {
+        r->kind = 'M';
+        s++;
+    } else {
+        r->kind = 'D';
+    }
+    if (r->kind == 'M') {
+        n = 0;
+        while (*s >= '0' && *s <= '9') n = n * 10 + (*s++ - '0');
+        r->mon = n;
+        if (*s++ != '.') return NULL;
+        n = 0;
+        while (*s >= '0' && *s <= '9') n = n * 10 + (*s++ - '0');
+        r->week = n;
+        if (*s++ != '.') return NULL;
+        n = 0;
+        while (*s >= '0' && *s <= '9') n = n * 10 + (*s++ - '0');
+        r->day = n;
+        if (r->mon < 1 || r->mon > 12 || r->week < 1 || r->week > 5 ||
+            r->day > 6) {
+            return NULL;
+        }
+    } else {
+        if (*s < '0' || *s > '9') return NULL;
+        n = 0;
+        while (*s >= '0' && *s <= '9') n = n * 10 + (*s++ - '0');
+        r->day = n;
+        if (r->kind == 'J' && (n < 1 || n > 365)) return NULL;
+        if (r->kind == 'D' && n > 365) return NULL;
+    }
+    r->secs = 2 * 3600;
+    if (*s == '/') {
+        s = parse_hms(s+1, &r->secs);
+    }
+    return s;
+}
+
+static int parse_footer(TzZone *z, char const *s)
+{
+    long off;
+
+    s = parse_abbr(s, z->std_abbr, sizeof(z->std_abbr));
+    if (!s) return 0;
+    s = parse_hms(s, &off);
+    if (!s) return 0;
+    /* POSIX offsets are west of UTC */
+    z->std_off = -off;
+    z->footer_dst = 0;
+    if (!*s) {
+        z->have_footer = 1;
+        return 1;
+    }
+    s = parse_abbr(s, z->dst_abbr, sizeof(z->dst_abbr));
+    if (!s) return 0;
+    z->dst_off = z->std_off + 3600;
+    if (*s && *s != ',') {
+        s = parse_hms(s, &off);
+        if (!s) return 0;
+        z->dst_off = -off;
+    }
+    /* A DST zone without explicit rules would need "posixrules";
+       leave those to the C library */
+    if (*s++ != ',') return 0;
+    s = parse_rule(s, &z->start);
+    if (!s || *s++ != ',') return 0;
+    s = parse_rule(s, &z->end);
+    if (!s || *s) return 0;
+    z->footer_dst = 1;
+    z->have_footer = 1;
+    return 1;
+}
+
+/* Instant at which rule r takes effect in year y, given the UTC
+   offset in effect just before it does */
+static long long rule_instant(TzRule const *r, long long y, long off)
+{
+    long long days = days_from_civil(y, 1, 1);
+    int wday, mday, dim;
+    static int const mdays[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+
+    switch(r->kind) {
+    case 'J':
+        days += r->day - 1;
+        if (is_leap(y) && r->day >= 60) days++;
+        break;
+    case 'D':
+        days += r->day;
+        break;
+    default:
+        days = days_from_civil(y, r->mon, 1);
+        /* 1970-01-01 was a Thursday */
+        wday = (int) (((days % 7) + 11) % 7);
+        mday = 1 + (r->day - wday + 7) % 7 + 7 * (r->week - 1);
+        dim = mdays[r->mon-1] + (r->mon == 2 && is_leap(y));
+        while (mday > dim) mday -= 7;
+        days += mday - 1;
+        break;
+    }
+    return days * SECS_PER_DAY + r->secs - off;
+}
+
+static void footer_lookup(TzZone const *z, long long t, long *off,
+                          int *isdst, char const **abbr)
+{
+    long long y, start, end;
+    int m, d, dst;
+
+    if (!z->footer_dst) {
+        *off = z->std_off;
+        *isdst = 0;
+        *abbr = z->std_abbr;
+        return;
+    }
+    civil_from_days((t >= 0 ? t : t - SECS_PER_DAY + 1) / SECS_PER_DAY, &y, &m, &d);
+    start = rule_instant(&z->start, y, z->std_off);
+    end = rule_instant(&z->end, y, z->dst_off);
+    if (start > end) {
+        /* Southern hemisphere: DST spans the new year */
+        dst = (t < end || t >= start);
+    } else {
+        dst = (t >= start && t < end);
+    }
+    *isdst = dst;
+    *off = dst ? z->dst_off : z->std_off;
+    *abbr = dst ? z->dst_abbr : z->std_abbr;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Loading TZif files                                         */
+/*                                                             */
+/***************************************************************/
+static unsigned char *read_file(char const *fname, size_t *len)
+{
+    FILE *fp = fopen(fname, "rb");
+    unsigned char *buf;
+    size_t n;
+
+    if (!fp) return NULL;
+    buf = malloc(TZ_MAX_FILE);
+    if (!buf) {
+        fclose(fp);
+        return NULL;
+    }
+    n = fread(buf, 1, TZ_MAX_FILE, fp);
+    fclose(fp);
+    if (n == 0 || n == TZ_MAX_FILE) {
+        free(buf);
+        return NULL;
+    }
+    *len = n;
+    return buf;
+}
+
+/* Read the counts from the TZif header at p.  Returns 0 if any is
+   negative or more than a file we'd read could hold; that keeps the
+   sizes worked out from them from wrapping around. */
+static int get_counts(unsigned char const *p, long *isutcnt, long *isstdcnt,
+                      long *leapcnt, long *timecnt, long *typecnt,
+                      long *charcnt)
+{
+    *isutcnt  = get_be32(p+20);
+    *isstdcnt = get_be32(p+24);
+    *leapcnt  = get_be32(p+28);
+    *timecnt  = get_be32(p+32);
+    *typecnt  = get_be32(p+36);
+    *charcnt  = get_be32(p+40);
+    return (*isutcnt >= 0 && *isutcnt <= TZ_MAX_FILE &&
+            *isstdcnt >= 0 && *isstdcnt <= TZ_MAX_FILE &&
+            *leapcnt >= 0 && *leapcnt <= TZ_MAX_FILE &&
+            *timecnt >= 0 && *timecnt <= TZ_MAX_FILE &&
+            *typecnt >= 0 && *typecnt <= TZ_MAX_FILE &&
+            *charcnt >= 0 && *charcnt <= TZ_MAX_FILE);
+}
+
+static int parse_tzif(TzZone *z, unsigned char const *buf, size_t len)
+{
+    unsigned char const *p = buf;
+    unsigned char const *end = buf + len;
+    long isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt;
+    int tsize = 4;
+    int i;
+    size_t need;
+
+    if (len < 44 || memcmp(p, "TZif", 4)) return 0;
+
+    /* For version 2+ files, skip the 32-bit block and use the 64-bit one */
+    if (p[4] >= '2') {
+        if (!get_counts(p, &isutcnt, &isstdcnt, &leapcnt, &timecnt,
+                        &typecnt, &charcnt)) {
+            return 0;
+        }
+        need = 44 + (size_t) timecnt * 5 + (size_t) typecnt * 6 +
+            (size_t) charcnt + (size_t) leapcnt * 8 +
+            (size_t) isstdcnt + (size_t) isutcnt;
+        /* There must be room for the second header after the block */
+        if (need > len || len - need < 44) return 0;
+        p += need;
+        if (memcmp(p, "TZif", 4)) return 0;
+        tsize = 8;
+    }
+    if (!get_counts(p, &isutcnt, &isstdcnt, &leapcnt, &timecnt,
+                    &typecnt, &charcnt)) {
+        return 0;
+    }
+
+    /* Leap-second ("right/") zones are left to the C library */
+    if (leapcnt != 0) return 0;
+    if (typecnt < 1 || typecnt > 256) return 0;
+
+    p += 44;
+    need = (size_t) timecnt * (tsize + 1) + (size_t) typecnt * 6 +
+        (size_t) charcnt + (size_t) isstdcnt + (size_t) isutcnt;
+    if ((size_t) (end - p) < need) return 0;
+
+    z->ntrans = (int) timecnt;
+    z->ntypes = (int) typecnt;
+    z->nchars = (int) charcnt;
+    z->trans = malloc(sizeof(long long) * (timecnt ? timecnt : 1));
+    z->idx = malloc(timecnt ? timecnt : 1);
+    z->types = malloc(sizeof(TzType) * typecnt);
+    z->chars = malloc(charcnt + 1);
+    if (!z->trans || !z->idx || !z->types || !z->chars) return 0;
+
+    for (i=0; i<timecnt; i++) {
+        z->trans[i] = (tsize == 8) ? get_be64(p) : get_be32(p);
+        p += tsize;
+    }
+    for (i=0; i<timecnt; i++) {
+        z->idx[i] = *p++;
+        if (z->idx[i] >= typecnt) return 0;
+    }
+    for (i=0; i<typecnt; i++) {
+        z->types[i].utoff = get_be32(p);
+        z->types[i].isdst = p[4];
+        z->types[i].abbr = p[5];
+        if (p[5] >= charcnt) return 0;
+        p += 6;
+    }
+    memcpy(z->chars, p, charcnt);
+    z->chars[charcnt] = 0;
+    p += charcnt + isstdcnt + isutcnt;
+
+    /* Footer: "\n<POSIX TZ string>\n" */
+    z->have_footer = 0;
+    if (tsize == 8 && p < end && *p == '\n') {
+        char footer[128];
+        size_t n = 0;
+        p++;
+        while (p < end && *p != '\n' && n + 1 < sizeof(footer)) {
+            footer[n++] = (char) *p++;
+        }
+        footer[n] = 0;
+        if (p < end && *p == '\n' && n > 0 && !parse_footer(z, footer)) {
+            z->bad_footer = 1;
+        }
+    }
+    return 1;
+}
+
+static void free_zone_data(TzZone *z)
+{
+    free(z->trans);
+    free(z->idx);
+    free(z->types);
+    free(z->chars);
+    z->trans = NULL;
+    z->idx = NULL;
+    z->types = NULL;
+    z->chars = NULL;
+    z->ntrans = 0;
+    z->ntypes = 0;
+}
+
+static void load_zone(TzZone *z)
+{
+    char const *name = z->name;
+    char const *dir;
+    unsigned char *buf;
+    size_t len;
+    DynamicBuffer fname;
+
+    z->usable = 0;
+
+    if (!name) {
+        name = TZ_DEFAULT_FILE;
+    } else {
+        if (*name == ':') name++;
+        /* Empty TZ means UTC; other oddities are the C library's business */
+        if (!*name || strstr(name, "..")) return;
+    }
+
+    DBufInit(&fname);
+    if (*name != '/') {
+        dir = getenv("TZDIR");
+        if (!dir || !*dir) dir = TZ_DEFAULT_DIR;
+        if (DBufPuts(&fname, dir) != OK ||
+            DBufPutc(&fname, '/') != OK) {
+            DBufFree(&fname);
+            return;
+        }
+    }
+    if (DBufPuts(&fname, name) != OK) {
+        DBufFree(&fname);
+        return;
+    }
+
+    buf = read_file(DBufValue(&fname), &len);
+    DBufFree(&fname);
+    if (!buf) return;
+
+    if (parse_tzif(z, buf, len)) {
+        z->usable = 1;
+        ZonesLoaded++;
+    } else {
+        free_zone_data(z);
+    }
+    free(buf);
+}
+
+static TzZone *find_zone(char const *name)
+{
+    TzZone *z;
+
+    for (z = Zones; z; z = z->next) {
+        if (!name && !z->name) return z;
+        if (name && z->name && !strcmp(name, z->name)) return z;
+    }
+    z = calloc(1, sizeof(TzZone));
+    if (!z) return NULL;
+    if (name) {
+        z->name = strdup(name);
+        if (!z->name) {
+            free(z);
+            return NULL;
+        }
+    }
+    load_zone(z);
+    z->next = Zones;
+    Zones = z;
+    return z;
+}
+
+/* UTC offset, DST flag and abbreviation in effect at instant t.  Returns
+   0 if the table can't answer and the C library must be asked instead. */
+static int zone_lookup(TzZone const *z, long long t, long *off, int *isdst,
+                       char const **abbr)
+{
+    int lo, hi, mid, i;
+    TzType const *ty;
+
+    if (z->ntrans == 0 || t < z->trans[0]) {
+        /* Before any transition: the first standard-time type */
+        for (i=0; i<z->ntypes; i++) {
+            if (!z->types[i].isdst) break;
+        }
+        if (i == z->ntypes) i = 0;
+        ty = &z->types[i];
+    } else if (t >= z->trans[z->ntrans-1]) {
+        if (z->have_footer) {
+            footer_lookup(z, t, off, isdst, abbr);
+            return 1;
+        }
+        if (z->bad_footer) return 0;
+        ty = &z->types[z->idx[z->ntrans-1]];
+    } else {
+        lo = 0;
+        hi = z->ntrans - 1;
+        /* Find last transition <= t */
+        while (hi - lo > 1) {
+            mid = lo + (hi - lo) / 2;
+            if (z->trans[mid] <= t) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        ty = &z->types[z->idx[lo]];
+    }
+    *off = ty->utoff;
+    *isdst = ty->isdst;
+    *abbr = z->chars + ty->abbr;
+    return 1;
+}
+
+static void fill_tm(long long local, int isdst, struct tm *tm)
+{
+    long long days, y;
+    long secs;
+    int m, d;
+
+    days = (local >= 0 ? local : local - SECS_PER_DAY + 1) / SECS_PER_DAY;
+    secs = (long) (local - days * SECS_PER_DAY);
+    civil_from_days(days, &y, &m, &d);
+    tm->tm_year = (int) (y - 1900);
+    tm->tm_mon = m - 1;
+    tm->tm_mday = d;
+    tm->tm_hour = (int) (secs / 3600);
+    tm->tm_min = (int) ((secs / 60) % 60);
+    tm->tm_sec = (int) (secs % 60);
+    tm->tm_wday = (int) (((days % 7) + 11) % 7);
+    tm->tm_yday = (int) (days - days_from_civil(y, 1, 1));
+    tm->tm_isdst = isdst;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  C library fallbacks, for zones we couldn't load.  These    */
+/*  temporarily switch TZ and put it back right away.          */
+/*                                                             */
+/***************************************************************/
+static int libc_localtime(char const *tz, time_t t, struct tm *tm,
+                          char *abbr, size_t len)
+{
+    struct tm const *res;
+
+    LibcLookups++;
+    (void) tz_set_tz(tz);
+    res = localtime_r(&t, tm);
+    if (res && abbr) {
+        abbr[0] = 0;
+        strftime(abbr, len, "%Z", tm);
+    }
+    (void) tz_set_tz(LocalTimeZone);
+    return res ? 1 : 0;
+}
+
+static time_t libc_mktime(char const *tz, struct tm *tm)
+{
+    time_t t;
+
+    LibcLookups++;
+    (void) tz_set_tz(tz);
+    t = mktime(tm);
+    (void) tz_set_tz(LocalTimeZone);
+    return t;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Public interface                                           */
+/*                                                             */
+/***************************************************************/
+
+static struct tm *zone_localtime(TzZone const *z, char const *tz,
+                                 time_t t, struct tm *tm)
+{
+    long off;
+    int isdst;
+    char const *abbr;
+
+    ZoneLookups++;
+    if (!z || !z->usable || !zone_lookup(z, (long long) t, &off, &isdst, &abbr)) {
+        return libc_localtime(tz, t, tm, NULL, 0) ? tm : NULL;
+    }
+    fill_tm((long long) t + off, isdst, tm);
+    return tm;
+}
+
+static time_t zone_mktime(TzZone const *z, char const *tz, struct tm *tm)
+{
+    long long local, t, y;
+    long before, after, off;
+    int isdst, mon;
+    char const *abbr;
+
+    ZoneLookups++;
+    if (!z || !z->usable) {
+        return libc_mktime(tz, tm);
+    }
+
+    /* Normalize the month, then let day arithmetic absorb the rest */
+    y = (long long) tm->tm_year + 1900 + tm->tm_mon / 12;
+    mon = tm->tm_mon % 12;
+    if (mon < 0) {
+        mon += 12;
+        y--;
+    }
+    local = (days_from_civil(y, mon+1, 1) + tm->tm_mday - 1) * SECS_PER_DAY +
+        (long long) tm->tm_hour * 3600 + (long long) tm->tm_min * 60 + tm->tm_sec;
+
+    /* Offsets in effect a day either side of this wall-clock time
+       bracket any transition that could affect it */
+    if (!zone_lookup(z, local - SECS_PER_DAY, &before, &isdst, &abbr) ||
+        !zone_lookup(z, local + SECS_PER_DAY, &after, &isdst, &abbr)) {
+        return libc_mktime(tz, tm);
+    }
+    t = local - before;
+    if (before != after) {
+        if (!zone_lookup(z, t, &off, &isdst, &abbr)) {
+            return libc_mktime(tz, tm);
+        }
+        /* Not valid with the earlier offset?  Then use the later one
+           if that works; otherwise we're in a gap */
+        if (off != before &&
+            zone_lookup(z, local - after, &off, &isdst, &abbr) &&
+            off == after) {
+            t = local - after;
+        }
+    }
+    if (!zone_lookup(z, t, &off, &isdst, &abbr)) {
+        return libc_mktime(tz, tm);
+    }
+    if ((long long) (time_t) t != t) return (time_t) -1;
+    fill_tm(t + off, isdst, tm);
+    return (time_t) t;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  tz_localtime_in                                            */
+/*                                                             */
+/*  Like localtime_r(), but in zone tz (NULL means TZ unset)   */
+/*                                                             */
+/***************************************************************/
+struct tm *tz_localtime_in(char const *tz, time_t const *t, struct tm *tm)
+{
+    return zone_localtime(find_zone(tz), tz, *t, tm);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  tz_mktime_in                                               */
+/*                                                             */
+/*  Like mktime() with tm_isdst = -1, but in zone tz.  Local   */
+/*  times that occur twice resolve to the earlier instant, and */
+/*  ones skipped by a transition are read with the offset in   */
+/*  effect before it, so 02:30 becomes 03:30 on a spring-      */
+/*  forward day.  tm is normalized as mktime() would.          */
+/*                                                             */
+/***************************************************************/
+time_t tz_mktime_in(char const *tz, struct tm *tm)
+{
+    return zone_mktime(find_zone(tz), tz, tm);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  tz_set_active                                              */
+/*                                                             */
+/*  Make tz the zone that tz_mktime(), tz_localtime_r() and    */
+/*  tz_abbrev() use.  This replaces switching the process's    */
+/*  TZ environment variable.                                   */
+/*                                                             */
+/***************************************************************/
+void tz_set_active(char const *tz)
+{
+    TzGeneration++;
+    ActiveZone = find_zone(tz);
+    ActiveName = ActiveZone ? ActiveZone->name : tz;
+    ActiveIsSet = 1;
+}
+
+static TzZone const *active_zone(void)
+{
+    if (!ActiveIsSet) tz_set_active(LocalTimeZone);
+    return ActiveZone;
+}
+
+char const *tz_get_active(void)
+{
+    (void) active_zone();
+    return ActiveName;
+}
+
+time_t tz_mktime(struct tm *tm)
+{
+    TzZone const *z = active_zone();
+    return zone_mktime(z, ActiveName, tm);
+}
+
+struct tm *tz_localtime_r(time_t const *t, struct tm *tm)
+{
+    TzZone const *z = active_zone();
+    return zone_localtime(z, ActiveName, *t, tm);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  tz_abbrev                                                  */
+/*                                                             */
+/*  Copy the active zone's abbreviation at instant t to buf    */
+/*                                                             */
+/***************************************************************/
+void tz_abbrev(time_t t, char *buf, size_t len)
+{
+    TzZone const *z = active_zone();
+    long off;
+    int isdst;
+    char const *abbr;
+    struct tm tm;
+
+    if (!len) return;
+    buf[0] = 0;
+    ZoneLookups++;
+    if (!z || !z->usable || !zone_lookup(z, (long long) t, &off, &isdst, &abbr)) {
+        (void) libc_localtime(ActiveName, t, &tm, buf, len);
+        return;
+    }
+    strncpy(buf, abbr, len-1);
+    buf[len-1] = 0;
+}
+
+void print_tz_stats(void)
+{
+    fprintf(ErrFp, "Time zones: %u loaded; %u lookups; %u via C library\n",
+            ZonesLoaded, ZoneLookups, LibcLookups);
+}
@@ -128,6 +128,7 @@ int DoFrename(ParsePtr p)
         DBufFree(&newbuf);
         return E_REDEF_BUILTIN_FUNC;
     }
+    DepOpaque();
     RenameUserFunc(DBufValue(&oldbuf), DBufValue(&newbuf));
     DBufFree(&oldbuf);
     DBufFree(&newbuf);
@@ -232,6 +233,8 @@ int DoFset(ParsePtr p)
         DBufFree(&buf);
         return OK;
     }
+    DepWrite('f', DBufValue(&buf));
+
     /* If the function exists and was defined at the same line of the same
        file, do nothing */
     existing = FindUserFunc(DBufValue(&buf));
@@ -462,10 +465,12 @@ static void FUnset(char const *name)
             }
         }
     }
+    DepWrite('f', name);
     UserFunc *f = FindUserFunc(name);
     if (f) {
         hash_table_delete(&FuncHash, f);
         DestroyUserFunc(f);
+        FuncGeneration++;
     }
 }
 
@@ -479,6 +484,7 @@ static void FUnset(char const *name)
 static void FSet(UserFunc *f)
 {
     hash_table_insert(&FuncHash, f);
+    FuncGeneration++;
 }
 
 UserFunc *FindUserFunc(char const *name)
@@ -486,6 +492,7 @@ UserFunc *FindUserFunc(char const *name)
    UserFunc *f;
    UserFunc candidate;
 
+   DepRead('f', name);
    StrnCpy(candidate.name, name, VAR_NAME_LEN);
 
    f = hash_table_find(&FuncHash, &candidate);
@@ -531,6 +538,59 @@ UnsetAllUserFuncs(void)
     }
     hash_table_free(&FuncHash);
     InitUserFunctions();
+    FuncGeneration++;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  UnsetScriptUserFuncs                                       */
+/*                                                             */
+/*  FUNSET all user funcs except those defined with -i on the  */
+/*  command line.  Used when the daemon reloads its script.    */
+/*                                                             */
+/***************************************************************/
+void
+UnsetScriptUserFuncs(void)
+{
+    UserFunc *f;
+    UserFunc *next;
+
+    f = hash_table_next(&FuncHash, NULL);
+    while(f) {
+        next = hash_table_next(&FuncHash, f);
+        if (strcmp(f->filename, "[cmdline]")) {
+            hash_table_delete_no_resize(&FuncHash, f);
+            DestroyUserFunc(f);
+        }
+        f = next;
+    }
+    FuncGeneration++;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  UnsetUserFuncsFromFile                                     */
+/*                                                             */
+/*  FUNSET all user funcs defined in the named file, so that   */
+/*  re-running the file defines them anew.                     */
+/*                                                             */
+/***************************************************************/
+void
+UnsetUserFuncsFromFile(char const *fname)
+{
+    UserFunc *f;
+    UserFunc *next;
+
+    f = hash_table_next(&FuncHash, NULL);
+    while(f) {
+        next = hash_table_next(&FuncHash, f);
+        if (!strcmp(f->filename, fname)) {
+            hash_table_delete_no_resize(&FuncHash, f);
+            DestroyUserFunc(f);
+        }
+        f = next;
+    }
+    FuncGeneration++;
 }
 
 /***************************************************************/
@@ -568,6 +628,7 @@ RenameUserFunc(char const *oldname, char const *newname)
 
     /* Insert into hash table */
     hash_table_insert(&FuncHash, f);
+    FuncGeneration++;
 }
 
 void
@@ -700,6 +761,7 @@ int PushUserFuncs(ParsePtr p)
     char const *name;
 
     DBufInit(&buf);
+    DepOpaque();
     PushedUserFuncs *pf = NEW(PushedUserFuncs);
     if (!pf) {
         return E_NO_MEM;
@@ -766,6 +828,7 @@ int PopUserFuncs(ParsePtr p)
     if (!pf) {
         return E_POPF_NO_PUSH;
     }
+    DepOpaque();
     UserFuncStack = UserFuncStack->next;
     if (DebugFlag & DB_PUSHPOP) {
         if (strcmp(pf->filename, GetCurrentFilename())) {
@@ -161,9 +161,8 @@ static int latitude_longitude_func(int do_set, Value *val, double *var, double m
         if (loc) {
             setlocale(LC_NUMERIC, loc);
         }
-        val->v.str = malloc(strlen(buf)+1);
+        val->v.str = DupStr(buf);
         if (!val->v.str) return E_NO_MEM;
-        strcpy(val->v.str, buf);
         val->type = STR_TYPE;
         return OK;
     }
@@ -226,9 +225,9 @@ static int warning_level_func(int do_set, Value *val)
         return OK;
     }
     if (!WarningLevel) {
-        val->v.str = strdup(VERSION);
+        val->v.str = DupStr(VERSION);
     } else {
-        val->v.str = strdup(WarningLevel);
+        val->v.str = DupStr(WarningLevel);
     }
     if (!val->v.str) {
         return E_NO_MEM;
@@ -262,9 +261,9 @@ static int oncefile_func(int do_set, Value *val)
         return OK;
     }
     if (!OnceFile) {
-        val->v.str = strdup("");
+        val->v.str = DupStr("");
     } else {
-        val->v.str = strdup(OnceFile);
+        val->v.str = DupStr(OnceFile);
     }
     if (!val->v.str) return E_NO_MEM;
     val->type = STR_TYPE;
@@ -282,6 +281,7 @@ static int terminal_bg_func(int do_set, Value *val)
 static int trig_time_func(int do_set, Value *val)
 {
     UNUSED(do_set);
+    DepNoteTrigger(0);
     if (LastTriggerTime != NO_TIME) {
         val->type = TIME_TYPE;
         val->v.val = LastTriggerTime;
@@ -295,6 +295,7 @@ static int trig_time_func(int do_set, Value *val)
 static int trig_date_func(int do_set, Value *val)
 {
     UNUSED(do_set);
+    DepNoteTrigger(0);
     if (!LastTrigValid) {
         val->type = INT_TYPE;
         val->v.val = 0;
@@ -308,6 +309,7 @@ static int trig_date_func(int do_set, Value *val)
 static int trig_base_func(int do_set, Value *val)
 {
     UNUSED(do_set);
+    DepNoteTrigger(0);
     if (LastTrigger.d != NO_DAY &&
         LastTrigger.m != NO_MON &&
         LastTrigger.y != NO_YR) {
@@ -323,6 +325,7 @@ static int trig_base_func(int do_set, Value *val)
 static int trig_until_func(int do_set, Value *val)
 {
     UNUSED(do_set);
+    DepNoteTrigger(0);
     if (LastTrigger.until == NO_UNTIL) {
         val->type = INT_TYPE;
         val->v.val = -1;
@@ -337,6 +340,7 @@ static int trig_day_func(int do_set, Value *val)
 {
     int d;
     UNUSED(do_set);
+    DepNoteTrigger(0);
     val->type = INT_TYPE;
     if (!LastTrigValid) {
         val->v.val = -1;
@@ -364,6 +368,7 @@ static int trig_mon_func(int do_set, Value *val)
 {
     int m;
     UNUSED(do_set);
+    DepNoteTrigger(0);
     val->type = INT_TYPE;
     if (!LastTrigValid) {
         val->v.val = -1;
@@ -379,6 +384,7 @@ static int trig_year_func(int do_set, Value *val)
 {
     int y;
     UNUSED(do_set);
+    DepNoteTrigger(0);
     val->type = INT_TYPE;
     if (!LastTrigValid) {
         val->v.val = -1;
@@ -394,6 +400,7 @@ static int trig_wday_func(int do_set, Value *val)
 {
     val->type = INT_TYPE;
     UNUSED(do_set);
+    DepNoteTrigger(0);
     if (!LastTrigValid) {
         val->v.val = -1;
         return OK;
@@ -456,10 +463,11 @@ static int today_wday_func(int do_set, Value *val)
 static int datetime_sep_func(int do_set, Value *val)
 {
     if (!do_set) {
-        val->v.str = malloc(2);
+        char buf[2];
+        buf[0] = DateTimeSep;
+        buf[1] = 0;
+        val->v.str = DupStr(buf);
         if (!val->v.str) return E_NO_MEM;
-        val->v.str[0] = DateTimeSep;
-        val->v.str[1] = 0;
         val->type = STR_TYPE;
         return OK;
     }
@@ -500,7 +508,7 @@ static int default_color_func(int do_set, Value *val)
     int col_r, col_g, col_b;
     if (!do_set) {
     /* 12 = strlen("255 255 255\0") */
-        val->v.str = malloc(12);
+        val->v.str = AllocStr(11);
         if (!val->v.str) return E_NO_MEM;
         snprintf(val->v.str, 12, "%d %d %d",
                  DefaultColorR,
@@ -537,10 +545,11 @@ static int default_color_func(int do_set, Value *val)
 static int date_sep_func(int do_set, Value *val)
 {
     if (!do_set) {
-        val->v.str = malloc(2);
+        char buf[2];
+        buf[0] = DateSep;
+        buf[1] = 0;
+        val->v.str = DupStr(buf);
         if (!val->v.str) return E_NO_MEM;
-        val->v.str[0] = DateSep;
-        val->v.str[1] = 0;
         val->type = STR_TYPE;
         return OK;
     }
@@ -556,10 +565,11 @@ static int date_sep_func(int do_set, Value *val)
 static int time_sep_func(int do_set, Value *val)
 {
     if (!do_set) {
-        val->v.str = malloc(2);
+        char buf[2];
+        buf[0] = TimeSep;
+        buf[1] = 0;
+        val->v.str = DupStr(buf);
         if (!val->v.str) return E_NO_MEM;
-        val->v.str[0] = TimeSep;
-        val->v.str[1] = 0;
         val->type = STR_TYPE;
         return OK;
     }
@@ -621,6 +631,7 @@ Var *FindVar(char const *str, int create)
     StrnCpy(v->name, str, VAR_NAME_LEN);
 
     hash_table_insert(&VHashTbl, v);
+    VarGeneration++;
     return v;
 }
 
@@ -635,6 +646,7 @@ static int DeleteVar(char const *str)
 {
     Var *v;
 
+    DepWrite('v', str);
     v = FindVar(str, 0);
     if (!v) return E_NOSUCH_VAR;
     if ((DebugFlag & DB_UNUSED_VARS) && !v->used_since_set) {
@@ -642,6 +654,8 @@ static int DeleteVar(char const *str)
     }
     DestroyValue(v->v);
     hash_table_delete(&VHashTbl, v);
+    VarGeneration++;
+    VarBindGeneration++;
     return OK;
 }
 
@@ -656,6 +670,7 @@ int SetVar(char const *str, Value *val, int nonconst_expr)
 {
     Var *v = NULL;
 
+    DepWrite('v', str);
     if (DebugFlag & DB_UNUSED_VARS) {
         v = FindVar(str, 0);
         if (v && !(v->used_since_set)) {
@@ -670,6 +685,7 @@ int SetVar(char const *str, Value *val, int nonconst_expr)
 
     DestroyValue(v->v);
     v->v = *val;
+    VarGeneration++;
     v->is_constant = ! nonconst_expr;
     v->used_since_set = 0;
     v->filename = GetCurrentFilename();
@@ -946,6 +962,8 @@ void DestroyVars(int all)
         hash_table_free(&VHashTbl);
         InitVars();
     }
+    VarGeneration++;
+    VarBindGeneration++;
 }
 
 /***************************************************************/
@@ -979,6 +997,8 @@ int DoPreserve (Parser *p)
     DynamicBuffer buf;
     DBufInit(&buf);
 
+    DepOpaque();
+
     r = ParseIdentifier(p, &buf);
     if (r) {
         DBufFree(&buf);
@@ -1082,7 +1102,7 @@ static SysVar SysVarArr[] = {
     {"LongMin",        1,  SPECIAL_TYPE, longmin_func,         0,      0 },
     {"LongSec",        1,  SPECIAL_TYPE, longsec_func,         0,      0 },
     {"March",          1,  TRANS_TYPE,   "March",              0,      0 },
-    {"MaxFullOmits",   0,  CONST_INT_TYPE, NULL,        MAX_FULL_OMITS, 0},
+    {"MaxFullOmits",   0,  CONST_INT_TYPE, NULL,        INT_MAX,        0},
     {"MaxLateMinutes", 1,  INT_TYPE,     &MaxLateMinutes,      0,      MINUTES_PER_DAY },
     {"MaxPartialOmits",0,  CONST_INT_TYPE, NULL,    MAX_PARTIAL_OMITS, 0},
     {"MaxSatIter",     1,  INT_TYPE,     &MaxSatIter,          10,     ANY },
@@ -1111,6 +1131,7 @@ static SysVar SysVarArr[] = {
     {"Saturday",       1,  TRANS_TYPE,   "Saturday",           0,      0 },
     {"September",      1,  TRANS_TYPE,   "September",          0,      0 },
     {"Shaded" ,        0,  INT_TYPE,     &Shaded,              0,      0 },
+    {"ShellCache",     1,  INT_TYPE,     &ShellCache,          -1,     ANY },
     {"SimpleCal",      0,  INT_TYPE,     &DoSimpleCalendar,    0,      0 },
     {"SortByDate",     0,  INT_TYPE,     &SortByDate,          0,      0 },
     {"SortByPrio",     0,  INT_TYPE,     &SortByPrio,          0,      0 },
@@ -1294,6 +1315,7 @@ PushVars(ParsePtr p)
     char const *name;
 
     PushedVars *pv = NEW(PushedVars);
+    DepOpaque();
     if (!pv) {
         return E_NO_MEM;
     }
@@ -1352,6 +1374,7 @@ PopVars(ParsePtr p)
     if (!pv) {
         return E_POPV_NO_PUSH;
     }
+    DepOpaque();
     VarStack = VarStack->next;
     if (DebugFlag & DB_PUSHPOP) {
         if (strcmp(pv->filename, GetCurrentFilename())) {
@@ -1394,6 +1417,7 @@ PopVars(ParsePtr p)
 
             /* Destructively copy value */
             dest->v = src->v;
+            VarGeneration++;
 
             /* Make sure free_pushedvars doesn't destroy our value! */
             src->v.type = ERR_TYPE;
@@ -1415,9 +1439,9 @@ static int GetTranslatableVariable(SysVar const *v, Value *value)
 {
     char const *translated = tr((char const *) v->value);
     if (translated) {
-        value->v.str = strdup(translated);
+        value->v.str = DupStr(translated);
     } else {
-        value->v.str = strdup("");
+        value->v.str = DupStr("");
     }
     if (!value->v.str) return E_NO_MEM;
     value->type = STR_TYPE;
@@ -1427,6 +1451,7 @@ static int GetTranslatableVariable(SysVar const *v, Value *value)
 static int SetSysVarHelper(SysVar *v, Value *value)
 {
     int r;
+    char *s;
     SysVarFunc f;
     if (!v->modifiable) {
         DestroyValue(*value);
@@ -1461,10 +1486,12 @@ static int SetSysVarHelper(SysVar *v, Value *value)
         }
 
         /* If it's a string variable, special measures must be taken */
+        s = strdup(value->v.str);
+        DestroyValue(*value);
+        if (!s) return E_NO_MEM;
         if (v->been_malloced) free(*((char **)(v->value)));
         v->been_malloced = 1;
-        *((char **) v->value) = value->v.str;
-        value->type = ERR_TYPE;  /* So that it's not accidentally freed */
+        *((char **) v->value) = s;
         return OK;
 
     default:
@@ -1489,6 +1516,8 @@ int SetSysVar(char const *name, Value *value)
         DestroyValue(*value);
         return E_NOSUCH_VAR;
     }
+    DepOpaque();
+    VarGeneration++;
     return SetSysVarHelper(v, value);
 }
 
@@ -1523,9 +1552,9 @@ int GetSysVar(SysVar const *v, Value *val)
     case STR_TYPE:
         val->type = v->type;
         if (! * (char **) v->value) {
-            val->v.str = strdup("");
+            val->v.str = DupStr("");
         } else {
-            val->v.str = strdup(*((char **) v->value));
+            val->v.str = DupStr(*((char **) v->value));
         }
         if (!val->v.str) return E_NO_MEM;
         return OK;
@@ -1570,6 +1599,192 @@ SysVar *FindSysVar(char const *name)
     return NULL;
 }
 
+/* The modifiable system variables as they were before the reminder
+   script first ran, so the daemon can reload the script in-process */
+static Value *SavedSysVars = NULL;
+
+/* The deprecated latitude/longitude components are covered by
+   $Latitude and $Longitude, and complain when they are set */
+static int is_latlong_component(SysVar const *v)
+{
+    SysVarFunc f = (SysVarFunc) v->value;
+    return (v->type == SPECIAL_TYPE &&
+            (f == latdeg_func || f == latmin_func || f == latsec_func ||
+             f == longdeg_func || f == longmin_func || f == longsec_func));
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SaveSysVars                                                */
+/*                                                             */
+/*  Remember the value of every modifiable system variable.    */
+/*  Translatable variables live in the translation table and   */
+/*  are not saved.                                             */
+/*                                                             */
+/***************************************************************/
+void SaveSysVars(void)
+{
+    size_t i;
+    SysVar const *v;
+    Value *val;
+
+    if (SavedSysVars) return;
+    SavedSysVars = calloc(NUMSYSVARS, sizeof(Value));
+    if (!SavedSysVars) return;
+
+    for (i=0; i<NUMSYSVARS; i++) {
+        v = SysVarArr + i;
+        val = SavedSysVars + i;
+        val->type = ERR_TYPE;
+        if (!v->modifiable || is_latlong_component(v)) continue;
+        switch(v->type) {
+        case INT_TYPE:
+            val->type = INT_TYPE;
+            val->v.val = *((int *) v->value);
+            break;
+        case STR_TYPE:
+            /* A NULL string is saved as a NULL string */
+            val->type = STR_TYPE;
+            val->v.str = NULL;
+            if (*((char **) v->value)) {
+                val->v.str = DupStr(*((char **) v->value));
+                if (!val->v.str) val->type = ERR_TYPE;
+            }
+            break;
+        case SPECIAL_TYPE:
+            if (((SysVarFunc) v->value)(0, val) != OK) {
+                val->type = ERR_TYPE;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RestoreSysVars                                             */
+/*                                                             */
+/*  Put the system variables back the way SaveSysVars found    */
+/*  them.                                                      */
+/*                                                             */
+/***************************************************************/
+void RestoreSysVars(void)
+{
+    size_t i;
+    SysVar *v;
+    Value const *val;
+    Value copy;
+
+    if (!SavedSysVars) return;
+    for (i=0; i<NUMSYSVARS; i++) {
+        v = SysVarArr + i;
+        val = SavedSysVars + i;
+        if (val->type == ERR_TYPE) continue;
+        switch(v->type) {
+        case INT_TYPE:
+            *((int *) v->value) = val->v.val;
+            break;
+        case STR_TYPE:
+            if (v->been_malloced) free(*((char **)(v->value)));
+            v->been_malloced = 0;
+            *((char **) v->value) = NULL;
+            if (val->v.str) {
+                *((char **) v->value) = strdup(val->v.str);
+                if (*((char **) v->value)) v->been_malloced = 1;
+            }
+            break;
+        case SPECIAL_TYPE:
+            if (CopyValue(&copy, val) == OK) {
+                (void) ((SysVarFunc) v->value)(1, &copy);
+                DestroyValue(copy);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    VarGeneration++;
+}
+
+/* The variables preserved before the reminder script first ran;
+   that is, the ones set with -i on the command line */
+static Var *SavedCmdLineVars = NULL;
+static int NumSavedCmdLineVars = 0;
+
+/***************************************************************/
+/*                                                             */
+/*  SaveCmdLineVars                                            */
+/*                                                             */
+/*  Remember every variable preserved so far, so that a reload */
+/*  can put back exactly those and nothing the script added.   */
+/*                                                             */
+/***************************************************************/
+void SaveCmdLineVars(void)
+{
+    Var *v;
+    Var *saved;
+    int n = 0;
+
+    if (SavedCmdLineVars) return;
+    v = hash_table_next(&VHashTbl, NULL);
+    while(v) {
+        if (v->preserve) n++;
+        v = hash_table_next(&VHashTbl, v);
+    }
+    if (!n) return;
+
+    SavedCmdLineVars = calloc(n, sizeof(Var));
+    if (!SavedCmdLineVars) return;
+
+    v = hash_table_next(&VHashTbl, NULL);
+    while(v) {
+        if (v->preserve) {
+            saved = SavedCmdLineVars + NumSavedCmdLineVars;
+            strcpy(saved->name, v->name);
+            saved->is_constant = v->is_constant;
+            saved->filename = v->filename;
+            saved->lineno = v->lineno;
+            if (CopyValue(&saved->v, &v->v) == OK) {
+                NumSavedCmdLineVars++;
+            }
+        }
+        v = hash_table_next(&VHashTbl, v);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RestoreCmdLineVars                                         */
+/*                                                             */
+/*  Throw away every variable, preserved or not, and put back  */
+/*  the ones SaveCmdLineVars found.                            */
+/*                                                             */
+/***************************************************************/
+void RestoreCmdLineVars(void)
+{
+    int i;
+    Var *v;
+    Var const *saved;
+
+    DestroyVars(1);
+    for (i=0; i<NumSavedCmdLineVars; i++) {
+        saved = SavedCmdLineVars + i;
+        v = FindVar(saved->name, 1);
+        if (!v) return;
+        if (CopyValue(&v->v, &saved->v) != OK) {
+            v->v.type = ERR_TYPE;
+        }
+        v->preserve = 1;
+        v->is_constant = saved->is_constant;
+        v->used_since_set = 1;
+        v->filename = saved->filename;
+        v->lineno = saved->lineno;
+    }
+    VarGeneration++;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  DumpSysVarByName                                           */
@@ -0,0 +1 @@
+#define VERSION "06.02.08"
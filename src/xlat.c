@@ -0,0 +1,104 @@
+#include <stddef.h>
+char const *translatables[] = {
+    "",
+    "%s function `%s' defined at %s(%s) does not use its argument",
+    "%s function `%s' defined at %s(%s) should take 1 argument but actually takes %d",
+    "%s is deprecated; use %s instead",
+    "%s(%d): IF without ENDIF",
+    "%s(%s): [#%d] %s function `%s'",
+    "(Security note: $RunOff variable tested.)",
+    "Accepting \"%s\" for $Latitude/$Longitude, but you should use the \"C\" locale decimal separator \".\" instead",
+    "Caching directory `%s' listing",
+    "Caching file `%s' in memory",
+    "Called from",
+    "Cannot open `%s' for writing: %s",
+    "Cannot stat %s - not running as daemon!",
+    "Cannot use AT clause in multitrig() function",
+    "Discarding cached copy of `%s'",
+    "Do not use [] around expression in SET command",
+    "Duplicate INFO headers are not permitted",
+    "Error adjusting trigger to local time zone",
+    "Error: THROUGH date earlier than start date",
+    "Executing `%s' for INCLUDECMD and caching as `%s'",
+    "Found cached directory listing for `%s'",
+    "Function `%s' defined at %s(%s) should take %d argument%s, but actually takes %d",
+    "Function `%s' redefined: previously defined at %s(%s)",
+    "Function definition considered non-constant because of context",
+    "GetValidHebDate: Bad adarbehave value %d",
+    "Global variable `%s' makes expression non-constant",
+    "Ignoring corrupt cache file `%s'",
+    "In",
+    "Invalid INFO string: Must be of the form \"Header: Value\"",
+    "Invalid translation: Both original and translated must have the same printf-style formatting sequences in the same order.",
+    "LANGID",
+    "Missing REM type; assuming MSG",
+    "No Adar A in %d",
+    "No substition function `%s' defined",
+    "No time zone file found for TZ `%s'... is it valid?",
+    "Non-constant built-in function `%s' makes expression non-constant",
+    "Non-constant expression converted to constant by `const' built-in function",
+    "Nonexistence of global variable `%s' makes value() non-constant",
+    "Not setting $OnceFile: Already processed a reminder with a ONCE clause",
+    "OMIT: UNTIL not allowed; did you mean THROUGH?",
+    "OMITFUNC counts as a non-constant expression",
+    "POP-FUNCS at %s:%d matches PUSH-FUNCS in different file: %s:%d",
+    "POP-OMIT-CONTEXT at %s:%d matches PUSH-OMIT-CONTEXT in different file: %s:%d",
+    "POP-VARS at %s:%d matches PUSH-VARS in different file: %s:%d",
+    "Potential function definition considered non-constant because of context",
+    "Potential variable assignment considered non-constant because of context",
+    "Re-running `%s'",
+    "Reading `%s': Found in cache",
+    "Reading `%s': Opening file on disk",
+    "Reading `-': Reading stdin",
+    "Reading cache file `%s'",
+    "Reading command `%s': Found in cache",
+    "Relative SCANFROM counts as a non-constant expression",
+    "SATISFY: constant 0 will never be true",
+    "SATISFY: constant \"\" will never be true",
+    "SATISFY: expression has no reference to trigdate() or $T...",
+    "SECURITY: Won't read non-root-owned file or directory when running as root!",
+    "SECURITY: Won't read world-writable file or directory!",
+    "Scanning directory `%s' for *.rem files",
+    "System variable `$%s' makes expression non-constant",
+    "The following variables were set, but not subsequently used:",
+    "Undefined %s function: `%s'",
+    "Unmatched PUSH-FUNCS at %s(%d)",
+    "Unmatched PUSH-OMIT-CONTEXT at %s(%d)",
+    "Unmatched PUSH-VARS at %s(%d)",
+    "Unrecognized command; interpreting as REM",
+    "User function `%s' defined in non-constant context makes expression non-constant",
+    "Variable assignment considered non-constant because of context",
+    "Warning: Consider using SCANFROM -28 with recurring ADDOMIT",
+    "Warning: Consider using SCANFROM -7 with recurring ADDOMIT",
+    "Warning: Consider using SCANFROM with recurring ADDOMIT",
+    "Warning: Function name `%s...' truncated to `%s'",
+    "Warning: OMIT is ignored if you use OMITFUNC",
+    "Warning: SCANFROM is ignored in two-argument form of evaltrig()",
+    "Warning: UNTIL/THROUGH date earlier than FROM date",
+    "Warning: UNTIL/THROUGH date earlier than SCANFROM date",
+    "Warning: UNTIL/THROUGH date earlier than start date",
+    "Warning: Unable to save ONCE timestamp to %s: %s",
+    "Warning: Unterminated %%(...) substitution sequence",
+    "Warning: Unterminated %%<...> substitution sequence",
+    "Warning: Unterminated %%{...} substitution sequence",
+    "Warning: Useless use of UNTIL with fully-specified date and no *rep",
+    "Warning: Variable name `%.*s...' truncated to `%.*s'",
+    "Writing cache file `%s'",
+    "You have OMITted everything!  The space-time continuum is at risk.",
+    "\\x00 is not a valid escape sequence",
+    "`%%%c' substitution sequence should not be used without an AT clause",
+    "`%s' UNSET without being used (previous SET: %s:%d)",
+    "`%s' re-SET without being used (previous SET: %s:%d)",
+    "are",
+    "days",
+    "defined at",
+    "did you mean",
+    "done",
+    "here",
+    "psmoon() is deprecated; use SPECIAL MOON instead.",
+    "psshade() is deprecated; use SPECIAL SHADE instead.",
+    "remaining call frames omitted",
+    "were",
+    "yesterday",
+    NULL
+};